@@ -10,6 +10,7 @@
 #include"arg_opt_parser.h"
 #include"common.h"
 #include"utils.h"
+#include"skew.h"
 #include<stdio.h>
 #include<stdlib.h>
 #include<string.h>
@@ -27,7 +28,7 @@ static void printVersion(const char *const name)
          "                   University of Stuttgart. All rights reserved.\n");
 }
 
-GlobalOpts GlOpts= { NULL, { 0, 1, false, false, false }, { 0.0, -1, false }, { -1, 0, false }, {32768.0, { false, false, false } } };
+GlobalOpts GlOpts= { NULL, { 0, 1, false, false, false, false }, { { 0.0 }, 0, -1, 0.0, NULL, 0, false, false }, { -1, NULL, 0, false }, false, {32768.0, { false, false, false }, 1, NULL, 0, { 0.0, 0.0 }, { 0.0, 0.0, 0.0, 0.0 }, NULL, { NULL, NULL, { 0, 0 }, false, NULL, 16, 1 } } };
 
 inline static void interpretSpecialEvtsOpts(GlobalOpts *const opts,
                                             char *const optArg)
@@ -78,6 +79,40 @@ inline static void interpretEagerLimitOpt(GlobalOpts *const opts,
   }
 }
 
+inline static void interpretSkewOpt(GlobalOpts *const opts,
+                                    const char *const optArg)
+{
+  if(NULL== optArg|| 0== strcmp("rank", optArg)) {
+    opts->sim_opts.skew= SKEW_PER_RANK;
+  } else if(0== strcmp("node", optArg)) {
+    opts->sim_opts.skew= SKEW_PER_NODE;
+  } else {
+    printf("Unknown clock-skew correction (%s)\n", optArg);
+  }
+}
+
+inline static void interpretLogGPOpt(GlobalOpts *const opts,
+                                     const char *const optArg)
+{
+  double *const x= opts->sim_opts.loggp;
+  if(4!= sscanf(optArg, "%lf,%lf,%lf,%lf", x, x+ 1, x+ 2, x+ 3)||
+     x[0]< 0.0|| x[1]< 0.0|| x[2]< 0.0|| x[3]< 0.0) {
+    Error("Invalid LogGP specification \"%s\"\n", optArg);
+    memset(x, 0, sizeof(double)* 4);
+  }
+}
+
+inline static void interpretWhatIfRegionOpt(GlobalOpts *const opts,
+                                            const char *const optArg)
+{
+  long long *const x= opts->sim_opts.whatif.region;
+  x[1]= 0;
+  if(sscanf(optArg, "%lld:%lld", x, x+ 1)< 1|| x[0]< 1|| x[1]< 0) {
+    Error("Invalid what-if region \"%s\"\n", optArg);
+    x[0]= x[1]= 0;
+  }
+}
+
 inline static void interpretMonTypes(GlobalOpts *const opts, char *const optArg)
 {
   char *ptr= strtok(optArg, ",\n ");
@@ -93,12 +128,31 @@ inline static void interpretMonTypes(GlobalOpts *const opts, char *const optArg)
   }
 }
 
+inline static void interpretWinLens(GlobalOpts *const opts, char *const optArg)
+{
+  const int nmax= sizeof(opts->win_mon.win_len)/ sizeof(double);
+  opts->win_mon.nwin_lens= 0;
+  char *ptr= strtok(optArg, ",\n ");
+  while(NULL!= ptr) {
+    const double x= atof(ptr);
+    if(x< 0.9) {
+      Error("Invalid monitoring window length (%.9e ns)\n", x);
+    } else if(opts->win_mon.nwin_lens< nmax) {
+      opts->win_mon.win_len[opts->win_mon.nwin_lens++]= x;
+    } else {
+      Error("Too many monitoring window lengths, ignoring %.9e ns\n", x);
+    }
+    ptr= strtok(NULL, ",\n ");
+  }
+}
+
 static struct argp_option showOpts[]= {
   { "show-reviews", 'R', "1", OPTION_ARG_OPTIONAL, "Stepwise review level in stdout (default: 0)", 0 },
   { "show-errors", 'E', "1", OPTION_ARG_OPTIONAL, "Error level in stdout (default: 1)", 0 },
   { "show-timings", 'T', 0, 0, "I/O progress and timings in stdout (default: no)", 2 },
   { "export-profile", 'X', 0, 0, "Quick profile in a separate file (default: no)", 1 },
   { "pretty-output", 'P', 0, 0, "Formatted end-output in stdout (default: no)", 1 },
+  { "show-protocols", 1001, 0, 0, "#messages and bytes per p2p protocol in stdout (default: no)", 1 },
   { 0 }
 };
 static error_t parseShowOpts(int key, char *arg, struct argp_state *state)
@@ -120,6 +174,9 @@ static error_t parseShowOpts(int key, char *arg, struct argp_state *state)
   case 'P':
     opts->show_opts.pretty= true;
     break;
+  case 1001:
+    opts->show_opts.protocols= true;
+    break;
   case ARGP_KEY_ARG:
     printf("ARGP_KEY_ARG(show)\n");
     break;
@@ -156,10 +213,15 @@ static struct argp showOptsParser= { showOpts, parseShowOpts, 0 };
 
 struct argp_option monOpts[]= {
   { "monitors", 'm', "window,event", 0, "Type of monitoring to perform", 0 },
-  { "wmon-len", 2101, "1.0e9", 0, "Monitoring window in ns (default: 1e9 ns)", 1 },
+  { "wmon-len", 2101, "1.0e9,4.0e9", 0, "Monitoring windows in ns (default: 1e9 ns)", 1 },
   { "wmon-sma", 2102, "1", 0, "#windows for simple moving average (default: 1)", 1 },
-  { "emon-rank", 2201, "0", 0, "Event-based monitoring rank (default: 0)", 2 },
+  { "wmon-adapt", 2104, "events:n|colls[:k]", 0, "Windows of n events over all ranks, or till every k-th collective over all ranks (default: fixed length)", 1 },
+  { "wmon-heatmap", 2105, "f32|u8", OPTION_ARG_OPTIONAL, "Per-rank useful and critical time of the windows in a binary file (default: no)", 1 },
+  { "wmon-ideal", 2106, 0, 0, "Windows on the ideal (replayed critical) time (default: elapsed)", 1 },
+  { "wmon-ema", 2103, "0.5", 0, "Weight of the newest window for exponential moving average (default: none)", 1 },
+  { "emon-rank", 2201, "0-3,8", 0, "Event-based monitoring rank(s), or comm:c (default: 0)", 2 },
   { "emon-nevts", 2202, "1", 0, "#events accumulated per data-point (default: 1)", 2 },
+  { "online-monitors", 2001, 0, 0, "Monitors accumulated during the replay (default: no)", 0 },
   { 0 }
 };
 static error_t parseMonOpts(int key, char *arg, struct argp_state *state)
@@ -170,16 +232,41 @@ static error_t parseMonOpts(int key, char *arg, struct argp_state *state)
     interpretMonTypes(opts, arg);
     break;
   case 2101:
-    opts->win_mon.win_len= atof(arg);
-    ErrorIf(opts->win_mon.win_len< 0.9,
-            "Invalid monitoring window length (%.9e ns)\n", opts->win_mon.win_len);
+    interpretWinLens(opts, arg);
     break;
   case 2102:
     opts->win_mon.nwins_sma= atoi(arg);
     ErrorIf(opts->win_mon.nwins_sma< 0.9,
             "Invalid #windows for moving-average (%d)\n", opts->win_mon.nwins_sma);
     break;
+  case 2104:
+    opts->win_mon.adapt= strdup(arg);
+    break;
+  case 2105:
+    if(NULL== arg|| 0== strcmp("f32", arg)) {
+      opts->win_mon.heatmap= 4;
+    } else if(0== strcmp("u8", arg)) {
+      opts->win_mon.heatmap= 1;
+    } else {
+      Error("Invalid heatmap format \"%s\"; using f32\n", arg);
+      opts->win_mon.heatmap= 4;
+    }
+    break;
+  case 2106:
+    opts->win_mon.ideal= true;
+    break;
+  case 2103:
+    opts->win_mon.ema= atof(arg);
+    if(opts->win_mon.ema<= 0.0|| opts->win_mon.ema> 1.0) {
+      Error("Invalid weight for exponential moving-average (%s)\n", arg);
+      opts->win_mon.ema= 0.0;
+    }
+    break;
   case 2201:
+    if(NULL!= strpbrk(arg, ",-:")) {
+      opts->evt_mon.ranks= strdup(arg);
+      break;
+    }
     opts->evt_mon.rank= atoi(arg);
     ErrorIf(opts->evt_mon.rank< 0,
             "Invalid event-based monitoring rank (%d)\n", opts->evt_mon.rank);
@@ -190,6 +277,9 @@ static error_t parseMonOpts(int key, char *arg, struct argp_state *state)
             "Invalid #events for event-based monitoring (%d)\n",
             opts->evt_mon.nevts_report);
     break;
+  case 2001:
+    opts->online_mon= true;
+    break;
   case ARGP_KEY_ARG:
     printf("ARGP_KEY_ARG(mon)\n");
     break;
@@ -227,6 +317,20 @@ static struct argp monOptsParser= { monOpts, parseMonOpts, 0 };
 static struct argp_option simOpts[]= {
   { "eager-limit", 3001, "32k", 0, "Eager limit (default: 32k)" },
   { "ignore-events", 3002, "traceability,flush,overhead", 0, "Trace-events as useful (default: none)" },
+  { "workers", 3003, "1", 0, "#processes sharing the replay (default: 1)" },
+  { "ranks", 3004, "0-3,8|comm:2", 0, "Ranks (0-based) or communicator to replay alone (default: all)" },
+  { "skew-correction", 3005, "rank|node", OPTION_ARG_OPTIONAL, "Shift clocks against illogical receives (default: no)" },
+  { "inter-latency", 3006, "0", 0, "Latency across nodes in ns (default: 0)" },
+  { "inter-bandwidth", 3007, "0", 0, "Bandwidth across nodes in GB/s (default: 0, i.e. infinite)" },
+  { "loggp", 3008, "L,o,g,G", 0, "LogGP network in ns and ns/B (default: none)" },
+  { "coll-algs", 3009, "Allreduce:ring,...", 0, "Algorithms of collectives: tree, ring, recdbl, pairwise (default: per collective)" },
+  { "whatif", 3010, "2,4", 0, "Speed-ups of useful bursts replayed along (default: none)" },
+  { "whatif-ranks", 3011, "0-3,8", 0, "Ranks (0-based) sped up (default: all)" },
+  { "whatif-region", 3012, "type[:value]", 0, "Event delimiting the regions sped up (default: whole bursts)" },
+  { "whatif-balance", 3013, 0, 0, "Replay along with useful time balanced between collectives (default: no)" },
+  { "noise", 3014, "gauss|exp|empirical[:scale]", 0, "Noise on useful bursts of replicas replayed along (default: none)" },
+  { "noise-replicas", 3015, "16", 0, "#replicas with noise (default: 16)" },
+  { "noise-seed", 3016, "1", 0, "Seed of the noise (default: 1)" },
   { 0 }
 };
 static error_t parseSimOpts(int key, char *arg, struct argp_state *state)
@@ -236,9 +340,59 @@ static error_t parseSimOpts(int key, char *arg, struct argp_state *state)
   case 3001:
     interpretEagerLimitOpt(opts, arg);
     break;
-  case 2102:
+  case 3002:
     interpretSpecialEvtsOpts(opts, arg);
     break;
+  case 3003:
+    opts->sim_opts.nworkers= atoi(arg);
+    ErrorIf(opts->sim_opts.nworkers< 1, "Invalid #workers (%d)\n",
+            opts->sim_opts.nworkers);
+    break;
+  case 3004:
+    opts->sim_opts.ranks= strdup(arg);
+    break;
+  case 3005:
+    interpretSkewOpt(opts, arg);
+    break;
+  case 3006:
+    opts->sim_opts.net.latency= atof(arg);
+    ErrorIf(opts->sim_opts.net.latency< 0.0, "Invalid latency (%.3e ns)\n",
+            opts->sim_opts.net.latency);
+    break;
+  case 3007:
+    opts->sim_opts.net.bandwidth= atof(arg);
+    ErrorIf(opts->sim_opts.net.bandwidth< 0.0, "Invalid bandwidth (%.3e GB/s)\n",
+            opts->sim_opts.net.bandwidth);
+    break;
+  case 3008:
+    interpretLogGPOpt(opts, arg);
+    break;
+  case 3009:
+    opts->sim_opts.coll_algs= strdup(arg);
+    break;
+  case 3010:
+    opts->sim_opts.whatif.factors= strdup(arg);
+    break;
+  case 3011:
+    opts->sim_opts.whatif.ranks= strdup(arg);
+    break;
+  case 3012:
+    interpretWhatIfRegionOpt(opts, arg);
+    break;
+  case 3013:
+    opts->sim_opts.whatif.balance= true;
+    break;
+  case 3014:
+    opts->sim_opts.whatif.noise= strdup(arg);
+    break;
+  case 3015:
+    opts->sim_opts.whatif.nreplicas= atoi(arg);
+    ErrorIf(opts->sim_opts.whatif.nreplicas< 1, "Invalid #replicas (%d)\n",
+            opts->sim_opts.whatif.nreplicas);
+    break;
+  case 3016:
+    opts->sim_opts.whatif.seed= strtoul(arg, NULL, 0);
+    break;
   case ARGP_KEY_ARG:
     printf("ARGP_KEY_ARG(sim)\n");
     break;
@@ -345,9 +499,18 @@ int ParseArgs(const int argc, char **argv)
   }
 
   if(GlOpts.win_mon.enabled) {
-    if(GlOpts.win_mon.win_len< 0.9) {
+    if(GlOpts.win_mon.nwin_lens< 1) {
       printf("Windowed monitoring: window-length is invalid (1.0e9 ns)\n");
-      GlOpts.win_mon.win_len= 1.0e9;
+      GlOpts.win_mon.win_len[0]= 1.0e9;
+      GlOpts.win_mon.nwin_lens= 1;
+    }
+    if(GlOpts.win_mon.ideal&& NULL!= GlOpts.win_mon.adapt) {
+      printf("Windowed monitoring: adaptive windows are on elapsed time (ignored)\n");
+      FREE_IF(GlOpts.win_mon.adapt);
+    }
+    if(GlOpts.win_mon.ideal&& GlOpts.online_mon) {
+      printf("Windowed monitoring: ideal time is known only after the replay (offline)\n");
+      GlOpts.online_mon= false;
     }
 #if 0
     if(GlOpts.win_mon.nwins_sma< 1) {
@@ -359,7 +522,9 @@ int ParseArgs(const int argc, char **argv)
 
   if(GlOpts.evt_mon.enabled) {
     if(GlOpts.evt_mon.rank< 0) {
-      printf("Event-based monitoring: rank is invalid (0)\n");
+      if(NULL== GlOpts.evt_mon.ranks) {
+        printf("Event-based monitoring: rank is invalid (0)\n");
+      }
       GlOpts.evt_mon.rank= 0;
     }
     if(GlOpts.evt_mon.nevts_report< 1) {
@@ -368,6 +533,14 @@ int ParseArgs(const int argc, char **argv)
     }
   }
 
+  if(NULL!= GlOpts.sim_opts.coll_algs) {
+    const double *const x= GlOpts.sim_opts.loggp;
+    if(GlOpts.sim_opts.net.latency<= 0.0&& GlOpts.sim_opts.net.bandwidth<= 0.0&&
+       x[0]<= 0.0&& x[1]<= 0.0&& x[2]<= 0.0&& x[3]<= 0.0) {
+      printf("Collective algorithms: cost only with --inter-latency, --inter-bandwidth or --loggp (ignored)\n");
+    }
+  }
+
   return ret;
 }
 
@@ -375,3 +548,14 @@ void ArgHelp()
 {
   argp_help(&mainOptsParser, stdout, ARGP_HELP_LONG, NULL);
 }
+void ArgFree()
+{
+  FREE_IF(GlOpts.filename);
+  FREE_IF(GlOpts.win_mon.adapt);
+  FREE_IF(GlOpts.evt_mon.ranks);
+  FREE_IF(GlOpts.sim_opts.ranks);
+  FREE_IF(GlOpts.sim_opts.coll_algs);
+  FREE_IF(GlOpts.sim_opts.whatif.factors);
+  FREE_IF(GlOpts.sim_opts.whatif.ranks);
+  FREE_IF(GlOpts.sim_opts.whatif.noise);
+}
@@ -11,5 +11,6 @@
 
 extern int ParseArgs(const int, char **);
 extern void ArgHelp();
+extern void ArgFree();
 
 #endif  /* REPLAY_ARG_OPT_PARSER_H__ */
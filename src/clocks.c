@@ -10,6 +10,8 @@
 #include"utils.h"
 #include"paraver.h"
 #include"clocks.h"
+#include"shm.h"
+#include"whatif.h"
 #include<stdio.h>
 #include<stdlib.h>
 #include<string.h>
@@ -76,6 +78,15 @@ inline static double critical(const int p) { return Clocks.critical[p]; }
 inline static void setCritical(const int p, const double t) { Clocks.critical[p]= t; }
 inline static void updateCritical(const int p, const double t) { Clocks.critical[p]+= t- since(p); }
 
+/* the what-if lanes see the same durations, but of useful bursts changed */
+inline static void updateLanes(const int p, const double t, const bool useful)
+{
+  const double d= t- since(p);
+  for(int l= 1; l< Clocks.nlanes; ++l) {
+    Clocks.critical[l* Clocks.np+ p]+= useful? WhatIfBurst(l, p, d): d;
+  }
+}
+
 inline static void elapse(const int p, const double t, const int evt) { setCurr(p, t, evt); setElapsed(p, t); }
 
 inline static void currCalc(const int p, const double t, const int evt)
@@ -84,6 +95,7 @@ inline static void currCalc(const int p, const double t, const int evt)
   case 0:                       /* useful */
     if(isTracing(p)) {
       updateCritical(p, t);
+      updateLanes(p, t, true);
       updateUseful(p, t);
     }
     break;
@@ -120,6 +132,7 @@ void ClockPlay(const int p, const double t, const int evt)
   }
 
   elapse(p, t, evt);
+  WhatIfStartBurst(p, 0);
 
   if(GlOpts.evt_mon.rank== p) {
     /* /\* TlOutput(maxElapsed(), maxTraced(p), Clocks.critical[pOfMaxCritical()], maxUseful(), avgUseful()); *\/ */
@@ -181,13 +194,83 @@ void ClockPauseTrace(const int p, const double t, const int evt)
          elapsed(p), critical(p));
 }
 
+/* Batched ClockPauseMPI/ClockPauseTrace/ClockPlay over n events needing only
+ * clock accounting (no messages, no collectives), the critical time of the
+ * i-th stored in crit[i]. Stops before any event that would need a diagnostic
+ * (disabling, ending, invalid, inconsistent pause) and returns #events done.
+ */
+long ClockPlaySpan(const int p, const long n, const long *const gids,
+                   const double *const at, const int *const id,
+                   double *const crit)
+{
+  int s= state(p);
+  double tsince= since(p), on= tracingSince(p);
+  double c= critical(p), u= Clocks.useful[p], tr= Clocks.traced[p],
+         fl= Clocks.flush[p];
+
+  long i= 0;
+  for(; i< n; ++i) {
+    const double t= at[gids[i]];
+    const int e= id[gids[i]];
+    const bool tracing= on> -0.1;
+    if(unlikely(-1== s)) {
+      break;
+    }
+    if(e> 0) {
+      if(unlikely(!tracing|| (isPaused(s)&& !SameTime(t, tsince)))) {
+        break;
+      }
+    } else if(e< 0&& -3!= e&& -4!= e) {
+      break;
+    }
+
+    /* currCalc */
+    if(0== s) {
+      if(tracing) {
+        c+= t- tsince;
+        u+= t- tsince;
+        for(int l= 1; l< Clocks.nlanes; ++l) {
+          Clocks.critical[l* Clocks.np+ p]+= WhatIfBurst(l, p, t- tsince);
+        }
+      }
+    } else if(-3== s) {
+      fl+= t- tsince;
+    }
+    if(tracing) {
+      tr+= t- tsince;
+    }
+
+    if(0== e&& !tracing) {
+      on= t;                    /* enable */
+    }
+    if(0== e) {
+      WhatIfStartBurst(p, i);
+    }
+    s= e;
+    tsince= t;
+    crit[i]= c;
+  }
+
+  if(i> 0) {
+    setCritical(p, c);
+    Clocks.useful[p]= u;
+    Clocks.traced[p]= tr;
+    Clocks.flush[p]= fl;
+    setTracing(p, on);
+    elapse(p, tsince, s);
+  }
+  return i;
+}
+
 void ClockStart(const int np, const double t0, const double *const pt0s)
 {
   for(int ip= 0; ip< np; ++ip) {
     const int pt0= pt0s[ip* 2];
 
     enable(ip, t0);
-    setCritical(ip, pt0);
+    for(int l= 0; l< Clocks.nlanes; ++l) {
+      Clocks.critical[l* np+ ip]= pt0;
+    }
     setTraced(ip, pt0);
     elapse(ip, pt0, 0);
   }
@@ -202,6 +285,7 @@ void ClockEnd(const int p, const double t, const double universeEnds)
   } else if(isCurrDisabled(p)) {
     addUseful(p, universeEnds- t);
   }
+  updateLanes(p, t, isCurrPlaying(p));
   updateCritical(p, t);
   updateTraced(p, t);
   elapse(p, t, -1);
@@ -225,8 +309,9 @@ void ClockInit(const int np)
   Clocks.useful= (double *) malloc(sizeof(double)* np);
   memset(Clocks.useful, 0, sizeof(double)* np);
 
-  Clocks.critical= (double *) malloc(sizeof(double)* np);
-  memset(Clocks.critical, 0, sizeof(double)* np);
+  Clocks.nlanes= WhatIfGetNumLanes();
+  Clocks.critical= (double *) malloc(sizeof(double)* np* Clocks.nlanes);
+  memset(Clocks.critical, 0, sizeof(double)* np* Clocks.nlanes);
 
   curr.state= (int *) malloc(sizeof(int)* np);
   memset(curr.state, 0, sizeof(int)* np);
@@ -239,6 +324,31 @@ void ClockInit(const int np)
 
   Clocks.np= np;
 }
+/* moves the clocks into/out of memory shared with replay workers */
+void ClockShare()
+{
+  const size_t size= sizeof(double)* Clocks.np;
+  Clocks.elapsed= ShmFromHeap(Clocks.elapsed, size);
+  Clocks.traced= ShmFromHeap(Clocks.traced, size);
+  Clocks.flush= ShmFromHeap(Clocks.flush, size);
+  Clocks.useful= ShmFromHeap(Clocks.useful, size);
+  Clocks.critical= ShmFromHeap(Clocks.critical, size* Clocks.nlanes);
+  curr.state= ShmFromHeap(curr.state, sizeof(int)* Clocks.np);
+  curr.since= ShmFromHeap(curr.since, size);
+  curr.onSince= ShmFromHeap(curr.onSince, size);
+}
+void ClockUnshare()
+{
+  const size_t size= sizeof(double)* Clocks.np;
+  Clocks.elapsed= ShmToHeap(Clocks.elapsed, size);
+  Clocks.traced= ShmToHeap(Clocks.traced, size);
+  Clocks.flush= ShmToHeap(Clocks.flush, size);
+  Clocks.useful= ShmToHeap(Clocks.useful, size);
+  Clocks.critical= ShmToHeap(Clocks.critical, size* Clocks.nlanes);
+  curr.state= ShmToHeap(curr.state, sizeof(int)* Clocks.np);
+  curr.since= ShmToHeap(curr.since, size);
+  curr.onSince= ShmToHeap(curr.onSince, size);
+}
 void ClockFinalize()
 {
   FREE_IF(curr.onSince);
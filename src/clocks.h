@@ -12,10 +12,15 @@
 
 extern void ClockInit(const int);
 extern void ClockFinalize();
+extern void ClockShare();
+extern void ClockUnshare();
 
 extern void ClockPlay(const int, const double, const int);
 extern void ClockPauseMPI(const int, const double, const int);
 extern void ClockPauseTrace(const int, const double, const int);
+extern long ClockPlaySpan(const int, const long, const long *const,
+                          const double *const, const int *const,
+                          double *const);
 
 extern void ClockStart(const int, const double, const double *const);
 extern void ClockEnd(const int, const double, const double);
@@ -25,8 +30,9 @@ typedef struct {
   double *traced;               /* runs unless disabled */
   double *flush;                /* runs when flushing */
   double *useful;               /* runs for useful events */
-  double *critical;             /* runs for useful and wait */
+  double *critical;             /* runs for useful and wait; per what-if lane */
   int np;
+  int nlanes;                   /* lane 0: the trace as recorded */
 } ClockType;
 
 extern ClockType Clocks;
@@ -67,6 +73,26 @@ inline static void ClockUpdateCritical(const int p, const double delta_t)
   Clocks.critical[p]+= delta_t;
 }
 
+/* critical clocks of the what-if lanes, see whatif.h */
+inline static int ClockGetNumLanes() { return Clocks.nlanes; }
+inline static double ClockGetLaneCritical(const int l, const int p) { return Clocks.critical[l* Clocks.np+ p]; }
+inline static void ClockSetLaneCritical(const int l, const int p,
+                                        const double t) { Clocks.critical[l* Clocks.np+ p]= t; }
+inline static void ClockUpdateLaneCritical(const int l, const int p,
+                                           const double delta_t) { Clocks.critical[l* Clocks.np+ p]+= delta_t; }
+/* waits till t, if later */
+inline static void ClockRaiseLaneCritical(const int l, const int p,
+                                          const double t)
+{
+  if(t> ClockGetLaneCritical(l, p)) {
+    if(0== l) {
+      ClockSetCritical(p, t);
+    } else {
+      ClockSetLaneCritical(l, p, t);
+    }
+  }
+}
+
 inline static double ClockGetMaxElapsed(const int np)
 {
   double elapsed= 0.0;
@@ -94,6 +120,15 @@ inline static double ClockGetMaxCritical(const int np)
   return critical;
 }
 
+inline static double ClockGetMaxLaneCritical(const int l, const int np)
+{
+  double critical= 0.0;
+  for(int ip= 0; ip< np; ++ip) {
+    critical= MAX(ClockGetLaneCritical(l, ip), critical);
+  }
+  return critical;
+}
+
 inline static double ClockGetMaxUseful(const int np)
 {
   double useful= 0.0;
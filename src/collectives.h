@@ -13,16 +13,53 @@
 #include"trace_data.h"
 #include"paraver.h"
 #include"clocks.h"
+#include"shm.h"
+#include"network.h"
+#include"whatif.h"
 #include<float.h>
 
-static struct {
-  double *entry;   /* critical time of entry */
-  bool *pexec;     /* whether proc is part of the comm - constant*/
+/* Every comm keeps a ring of in-flight instances, so that a rank can enter
+ * the next collective while others are still leaving the previous one.
+ * Instance (per-rank sequence number) s lives in slot s% COLLS_NSLOTS, once
+ * the last member has left instance s- COLLS_NSLOTS.
+ * A member's stamp tells its instance: 2*s+ 1 after entering s, 2*s+ 2 after
+ * leaving s. The entry is valid only while the stamp is odd.
+ * Slots are shared by the members, possibly replayed by different workers:
+ * they are updated atomically, and a reset slot is published by its seq.
+ * What-if lanes keep their own entries, and max and last per slot, set before
+ * those of lane 0 are.
+ */
+#define COLLS_NSLOTS 8
+
+typedef struct {
+  long seq;        /* instance held by the slot */
+  double max;      /* running max of the entries */
+  double bound;    /* running min of recorded exits, for members left out */
+  double bytes;    /* running max of the bytes moved by a member */
   double last;
   int nremains;    /* #memebers remains to enter in this collective */
+  int nleft;       /* #memebers left this collective */
   int evt;         /* collective-event-id */
+} CollSlot;
+
+static struct {
+  double *entry;   /* critical time of entry */
+  long *stamp;     /* instance-stamp of entry */
+  bool *pexec;     /* whether proc is part of the comm - constant*/
+  double *lanes;   /* entries of lanes 1.., then max and last per slot */
+  CollSlot slot[COLLS_NSLOTS];
 } *Colls= NULL;
 
+/* #doubles per comm for the what-if lanes */
+inline static long collsLanesSize() { return (WhatIfGetNumLanes()- 1)* (TraceGetNumProcs()+ 2* COLLS_NSLOTS); }
+inline static double *collLaneEntries(const int c, const int l) { return Colls[c].lanes+ (l- 1)* TraceGetNumProcs(); }
+inline static double *collLaneSlot(const int c, const long seq, const int l)
+{
+  const int nl= WhatIfGetNumLanes()- 1;
+  return Colls[c].lanes+ nl* TraceGetNumProcs()+
+         2* ((seq% COLLS_NSLOTS)* nl+ l- 1);
+}
+
 static void CollsAlloc()
 {
   const long nc= TraceGetNumComms();
@@ -39,20 +76,33 @@ static void CollsAlloc()
   const int np= TraceGetNumProcs();
   double *entry= (double *) malloc(sizeof(double)* ncvalid* np);
   memset(entry, 0, sizeof(double)* ncvalid* np);
+  long *stamp= (long *) malloc(sizeof(long)* ncvalid* np);
+  memset(stamp, 0, sizeof(long)* ncvalid* np);
   bool *pexec= (bool *) malloc(sizeof(bool)* ncvalid* np);
   memset(pexec, 0, sizeof(bool)* ncvalid* np);
+  const long nlanes= collsLanesSize();
+  double *lanes= NULL;
+  if(nlanes> 0) {
+    lanes= (double *) malloc(sizeof(double)* ncvalid* nlanes);
+    memset(lanes, 0, sizeof(double)* ncvalid* nlanes);
+  }
   double *eptr= entry;
+  long *sptr= stamp;
   bool *xptr= pexec;
+  double *lptr= lanes;
   for(long c= 0; c< nc; ++c) {
-    Colls[c].evt= -1;
-    Colls[c].last= -1.0;
-
     if(TraceIsCommSelf(c)) {
       continue;  /* COMM_SELF */
     }
 
     Colls[c].entry= eptr;
     eptr+= np;
+    Colls[c].stamp= sptr;
+    sptr+= np;
+    if(nlanes> 0) {
+      Colls[c].lanes= lptr;
+      lptr+= nlanes;
+    }
 
     for(int i= 0; i< TraceGetCommSize(c); ++i) {
       xptr[TraceGetCommRank(c, i)]= true;
@@ -61,6 +111,49 @@ static void CollsAlloc()
     xptr+= np;
   }
 }
+/* moves the collective state into/out of memory shared with replay workers;
+ * the entries and stamps of all comms are one block each, in comm order
+ */
+static void collsMove(void *(*move)(void *const, const size_t))
+{
+  const long nc= TraceGetNumComms();
+  const int np= TraceGetNumProcs();
+  long c0= -1, ncvalid= 0;
+  for(long c= 0; c< nc; ++c) {
+    if(TraceIsCommSelf(c)) {
+      continue;
+    }
+    if(c0< 0) {
+      c0= c;
+    }
+    ++ncvalid;
+  }
+  Colls= move(Colls, sizeof(*Colls)* nc);
+  if(ncvalid< 1) {
+    return;
+  }
+
+  double *entry= move(Colls[c0].entry, sizeof(double)* ncvalid* np);
+  long *stamp= move(Colls[c0].stamp, sizeof(long)* ncvalid* np);
+  const long nlanes= collsLanesSize();
+  double *lanes= nlanes> 0? move(Colls[c0].lanes,
+                                 sizeof(double)* ncvalid* nlanes): NULL;
+  for(long c= 0; c< nc; ++c) {
+    if(TraceIsCommSelf(c)) {
+      continue;
+    }
+    Colls[c].entry= entry;
+    entry+= np;
+    Colls[c].stamp= stamp;
+    stamp+= np;
+    if(nlanes> 0) {
+      Colls[c].lanes= lanes;
+      lanes+= nlanes;
+    }
+  }
+}
+static void CollsShare() { collsMove(ShmFromHeap); }
+static void CollsUnshare() { collsMove(ShmToHeap); }
 #if 0
 static void CollsFree()
 {
@@ -74,90 +167,145 @@ static void CollsFree()
 }
 #endif
 
-static void CollsResetOneColl(const int c)
+static void CollsResetOneSlot(const int c, const int k, const long seq)
 {
-  Debug1("Resetting collective of comm-%d\n", c);
-  Colls[c].nremains= TraceGetCommSize(c);
-  Colls[c].evt= -1;
-  Colls[c].last= -1.0;
-  if(TraceIsCommSelf(c)) {
-    return;
-  }
-  for(int ip= 0; ip< TraceGetCommSize(c); ++ip) {
-    Colls[c].entry[TraceGetCommRank(c, ip)]= -1.0;
+  Debug1("Resetting collective slot-%d of comm-%d for instance-%ld\n", k, c,
+         seq);
+  CollSlot *const slot= Colls[c].slot+ k;
+  slot->nremains= TraceGetCommSize(c);
+  slot->nleft= 0;
+  slot->evt= -1;
+  slot->max= -1.0;
+  slot->bound= DBL_MAX;
+  slot->bytes= 0.0;
+  slot->last= -1.0;
+  for(int l= 1; NULL!= Colls[c].lanes&& l< WhatIfGetNumLanes(); ++l) {
+    double *const lane= collLaneSlot(c, k, l);
+    lane[0]= -1.0;              /* max */
+    lane[1]= -1.0;              /* last */
   }
+  ShmStoreLong(&slot->seq, seq);
 }
 static void CollsResetAll()
 {
   for(int c= 0; c< TraceGetNumComms(); ++c) {
-    CollsResetOneColl(c);
+    for(int k= 0; k< COLLS_NSLOTS; ++k) {
+      CollsResetOneSlot(c, k, k);
+    }
   }
 }
 
-inline static int GetCollEvt(const int c) { return Colls[c].evt; }
-inline static bool IsCollActive(const int c) { return Colls[c].evt> 0; }
-inline static bool IsCollAvailable(const int c, const int p) { return -1.0!= Colls[c].entry[p]; }
-inline static const char *GetCollName(const int c) { return GetParaverMPIEvtName(Colls[c].evt); }
-inline static void ActivateColl(const int c, const int p, const int evt)
+/* instance the member is in, or enters next */
+inline static long CollGetSeq(const int c, const int p) { return Colls[c].stamp[p]/ 2; }
+inline static CollSlot *CollGetSlot(const int c, const long seq) { return Colls[c].slot+ (seq% COLLS_NSLOTS); }
+inline static CollSlot *CollGetProcSlot(const int c, const int p) { return CollGetSlot(c, CollGetSeq(c, p)); }
+/* instance still occupying the slot needed by the member */
+inline static long CollGetBusySeq(const int c, const int p) { return ShmLoadLong(&CollGetProcSlot(c, p)->seq); }
+
+inline static int GetCollEvt(const int c, const int p) { return CollGetProcSlot(c, p)->evt; }
+inline static bool IsCollActive(const int c, const int p) { return GetCollEvt(c, p)> 0; }
+/* true if the member cannot enter its next instance yet */
+inline static bool IsCollAvailable(const int c, const int p) { return CollGetBusySeq(c, p)!= CollGetSeq(c, p); }
+inline static bool CollMemberHasEntered(const int c, const int p,
+                                        const long seq) { return Colls[c].stamp[p]>= 2* seq+ 1; }
+inline static bool CollMemberHasLeft(const int c, const int p,
+                                     const long seq) { return Colls[c].stamp[p]>= 2* seq+ 2; }
+inline static const char *GetCollName(const int c, const int p) { return GetParaverMPIEvtName(GetCollEvt(c, p)); }
+/* the first member to enter activates; returns false if already active */
+inline static bool ActivateColl(const int c, const int p, const int evt)
 {
   ErrorIf(TraceIsCommSelf(c), "%d: activating coll %s with COMM_SELF!\n", p,
           GetParaverMPIEvtName(evt));
-  ErrorIf(IsCollActive(c),
-          "%d: activating coll %s: already active collective %s(%d)\n",
-          p, GetParaverMPIEvtName(evt), GetCollName(c), c);
 
+  int inactive= -1;
+  if(!ShmSwapIntIf(&CollGetProcSlot(c, p)->evt, &inactive, evt)) {
+    return false;
+  }
   Debug1("%d: trigger coll %s(%d) - %d/%d\n", p, GetParaverMPIEvtName(evt), c,
-         Colls[c].nremains, TraceGetCommSize(c));
-  Colls[c].evt= evt;
+         ShmLoadInt(&CollGetProcSlot(c, p)->nremains), TraceGetCommSize(c));
+  return true;
 }
 
-inline static bool EveryoneEnteredColl(const int c) { return 0== Colls[c].nremains&& TraceGetCommSize(c)> 0; }
-inline static bool LastCollEntryEstablished(const int c) { return -1.0!= Colls[c].last; }
+inline static bool EveryoneEnteredColl(const int nremains,
+                                       const int c) { return 0== nremains&& TraceGetCommSize(c)> 0; }
+inline static bool LastCollEntryEstablished(CollSlot *const slot) { return -1.0!= ShmLoadDouble(&slot->last); }
 
 inline static void EnterColl(const int c, const int p, const double t,
                              const int evt)
 {
-  ErrorIf(-1.0!= Colls[c].entry[p],
+  const long seq= CollGetSeq(c, p);
+  ErrorIf(CollMemberHasEntered(c, p, seq),
           "%d: coll %s(%d) since crit-%.0lf, overwrite at crit-%.0lf (elapsed-%.0lf)\n",
-          p, GetCollName(c), c, Colls[c].entry[p], ClockGetCritical(p), t);
+          p, GetCollName(c, p), c, Colls[c].entry[p], ClockGetCritical(p), t);
 
-  if(!IsCollActive(c)) {
-    ActivateColl(c, p, evt);
-  }
+  ActivateColl(c, p, evt);
+  CollSlot *const slot= CollGetSlot(c, seq);
   Colls[c].entry[p]= ClockGetCritical(p);
-  --(Colls[c].nremains);
+  Colls[c].stamp[p]= 2* seq+ 1;
+  ShmMaxDouble(&slot->max, Colls[c].entry[p]);
+  for(int l= 1; l< WhatIfGetNumLanes(); ++l) {
+    collLaneEntries(c, l)[p]= ClockGetLaneCritical(l, p);
+    ShmMaxDouble(collLaneSlot(c, seq, l), ClockGetLaneCritical(l, p));
+  }
+  if(!NetIsIdeal()) {
+    ShmMaxDouble(&slot->bytes, TraceGetBytesCurrProcColl(p));
+  }
+  if(TraceGetCommNumOutside(c)> 0) {
+    /* members left out of the replay entered before anyone recorded leaving */
+    ShmMinDouble(&slot->bound, TraceGetAtCurrProcColl(p, 1));
+  }
+  const int nremains= ShmAddInt(&slot->nremains, -1);
 
   Debug1("%d: coll %s(%d) enter at %.0lf (critical: %.0lf) - %d/%d remains\n", p,
-         GetCollName(c), c, t, ClockGetCritical(p), Colls[c].nremains,
+         GetCollName(c, p), c, t, ClockGetCritical(p), nremains,
          TraceGetCommSize(c));
 
-  if(EveryoneEnteredColl(c)) {
-    ErrorIf(-1.0!= Colls[c].last,
+  if(EveryoneEnteredColl(nremains, c)) {
+    ErrorIf(LastCollEntryEstablished(slot),
             "%d: everyone just entered coll %s(%d), but last entry already set at %.0lf\n",
-            p, GetCollName(c), c, Colls[c].last);
-    double last= 0.0;
-    for(int ip= 0; ip< TraceGetCommSize(c); ++ip) {
-      last= MAX(Colls[c].entry[TraceGetCommRank(c, ip)], last);
+            p, GetCollName(c, p), c, slot->last);
+    const double cost= NetGetCollCost(c, ShmLoadInt(&slot->evt),
+                                      ShmLoadDouble(&slot->bytes));
+    const bool bounded= TraceGetCommNumOutside(c)> 0;
+    const double bound= bounded? ShmLoadDouble(&slot->bound): 0.0;
+    for(int l= 1; l< WhatIfGetNumLanes(); ++l) {
+      double *const lane= collLaneSlot(c, seq, l);
+      const double lmax= ShmLoadDouble(lane)+ cost;
+      ShmStoreDouble(lane+ 1, MAX(MAX(lmax, bound), 0.0));
     }
-    Debug1("%d: last-critical-entry into coll %s at %.0lf\n", p, GetCollName(c),
-           last);
-    Colls[c].last= last;
+    double max= ShmLoadDouble(&slot->max)+ cost;
+    if(bounded) {
+      max= MAX(max, bound);
+    }
+    Debug1("%d: last-critical-entry into coll %s at %.0lf\n", p,
+           GetCollName(c, p), max);
+    ShmStoreDouble(&slot->last, MAX(max, 0.0));
   }
 }
 /* return 0 if finished, 1 otherwise */
 inline static int LeaveColl(const int c, const int p, const double t,
                             const int collEvt)
 {
-  if(!LastCollEntryEstablished(c)) {
+  const long seq= CollGetSeq(c, p);
+  CollSlot *const slot= CollGetSlot(c, seq);
+  if(!LastCollEntryEstablished(slot)) {
     return 1;
   }
-  ClockUpdateCritical(p, Colls[c].last- Colls[c].entry[p]);
-  ++(Colls[c].nremains);
+  ClockUpdateCritical(p, slot->last- Colls[c].entry[p]);
+  for(int l= 1; l< WhatIfGetNumLanes(); ++l) {
+    ClockUpdateLaneCritical(l, p, ShmLoadDouble(collLaneSlot(c, seq, l)+ 1)-
+                            collLaneEntries(c, l)[p]);
+  }
+  Colls[c].stamp[p]= 2* seq+ 2;
+  const int evt= ShmLoadInt(&slot->evt);
+  ErrorIf(evt!= collEvt, "%d: leaving coll %s(%d) entered as %s\n", p,
+          GetParaverMPIEvtName(collEvt), c, GetParaverMPIEvtName(evt));
+  const int nleft= ShmAddInt(&slot->nleft, 1);
   Debug1("%d: coll %s(%d) leave at %.0lf (critical: %.0lf) - %d/%d done\n", p,
-         GetCollName(c), c, t, ClockGetCritical(p), Colls[c].nremains,
+         GetParaverMPIEvtName(evt), c, t, ClockGetCritical(p), nleft,
          TraceGetCommSize(c));
-  if(TraceGetCommSize(c)== Colls[c].nremains) {
-    CollsResetOneColl(c);
+  if(TraceGetCommSize(c)== nleft) {
+    CollsResetOneSlot(c, seq% COLLS_NSLOTS, seq+ COLLS_NSLOTS);
   }
   return 0;
 }
@@ -23,20 +23,29 @@ typedef struct {
     bool timings;
     bool profile;
     bool pretty;
+    bool protocols;
   } show_opts;
 
   struct {
-    double win_len;
+    double win_len[8];          /* ns, each written to its own file */
+    int nwin_lens;
     int nwins_sma;
+    double ema;                 /* weight of the newest window, 0: none */
+    char *adapt;                /* window bounds, see monitoring.c */
+    int heatmap;                /* bytes per value, 0: none */
+    bool ideal;                 /* bins on the replayed critical time */
     bool enabled;
   } win_mon;
 
   struct {
     int rank;
+    char *ranks;                /* several, see monitoring.c */
     int nevts_report;
     bool enabled;
   } evt_mon;
 
+  bool online_mon;              /* monitors accumulated during the replay */
+
   struct {
     double eager_limit;
     struct {
@@ -44,6 +53,24 @@ typedef struct {
       bool flush_evts;
       bool disabled_tracing;
     } ignore;
+    int nworkers;
+    char *ranks;                /* NULL: all */
+    int skew;                   /* clock-skew correction, see skew.h */
+    struct {
+      double latency;           /* ns */
+      double bandwidth;         /* B/ns, aka GB/s; 0: infinite */
+    } net;                      /* across nodes */
+    double loggp[4];            /* L, o, g in ns, G in ns/B; all 0: off */
+    char *coll_algs;            /* NULL: defaults, see paraver.h */
+    struct {
+      char *factors;            /* speed-ups of useful bursts; NULL: none */
+      char *ranks;              /* ranks sped up; NULL: all */
+      long long region[2];      /* event type and value delimiting bursts */
+      bool balance;             /* perfect load balance */
+      char *noise;              /* distribution of noise; NULL: none */
+      int nreplicas;            /* #replicas perturbed by noise */
+      unsigned long seed;
+    } whatif;                   /* see whatif.h */
   } sim_opts;
 } GlobalOpts;
 
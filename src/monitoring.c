@@ -10,17 +10,20 @@
 #include"trace_data.h"
 #include"common.h"
 #include"utils.h"
+#include"shm.h"
 #include<float.h>
+#include<stdint.h>
 
-inline static FILE *emFileOpen()
+/* one file per monitored rank if there are more than one */
+inline static FILE *emFileOpen(const int rank, const bool several)
 {
-  const int len= strlen(GlOpts.filename)+ 8;
+  const int len= strlen(GlOpts.filename)+ 32;
   char *fn= (char *) malloc(sizeof(char)* len);
-  memset(fn, 0, sizeof(char)* len);
-  memcpy(fn, GlOpts.filename, sizeof(char)* (len- 8));
-  /* printf("fn0= \"%s\"\n", fn); */
-  strcat(fn, ".em.dat");
-  /* printf("fn1= \"%s\", fn[-3]= '%c', fn[-2]= '%c', fn[-1]= '%c'\n", fn, fn[len- 3], fn[len- 2], fn[len- 1]); */
+  if(several) {
+    snprintf(fn, len, "%s.em.%d.dat", GlOpts.filename, rank);
+  } else {
+    snprintf(fn, len, "%s.em.dat", GlOpts.filename);
+  }
 
   FILE *fp= fopen(fn, "w");
   FREE_IF(fn);
@@ -34,88 +37,66 @@ inline static FILE *emFileOpen()
 #define EM_LAST EM_UAVG
 #define EM_NCOMPS (EM_LAST+1)
 
+/* the last nspans+ 1 points in a ring, cumulative: a local metric is the
+ * difference of the newest and the oldest
+ */
 static struct {
   FILE *fp;
   double *history[EM_NCOMPS];
   int nspans;
-
-  struct {
-    double elapsed;
-    double *onSince;
-    double traced;
-    double critical;
-    double *useful;
-    double pfactor;
-    struct {
-      double *since;
-      int *state;
-    } curr;
-    int np;
-  } clocks;
-} em= { NULL, { NULL }, 2, { 0.0, NULL, 0.0, 0.0, NULL, 0.0, { NULL, NULL }, 0 } };
+  int newest;
+} em= { NULL, { NULL }, 2, 0 };
+inline static double emNewest(const int i) { return em.history[i][em.newest]; }
+inline static double emOldest(const int i) { return em.history[i][em.newest== em.nspans? 0: em.newest+ 1]; }
 inline static void emPushHistory(const double traced, const double critical,
                                  const double umax, const double uavg)
 {
-  for(int i= EM_TRAC; i< EM_NCOMPS; ++i) {
-    memmove(em.history[i], em.history[i]+ 1, sizeof(double)* em.nspans);
-  }
-  em.history[EM_TRAC][em.nspans]= traced;
-  em.history[EM_CRIT][em.nspans]= critical;
-  em.history[EM_UMAX][em.nspans]= umax;
-  em.history[EM_UAVG][em.nspans]= uavg;
-}
-inline static void emUsefuls(double *const umaxp, double *const uavgp)
-{
-  double umax= 0.0, uavg= 0.0;
-  for(int ip= 0; ip< em.clocks.np; ++ip) {
-    uavg+= em.clocks.useful[ip];
-    umax= MAX(em.clocks.useful[ip], umax);
-  }
-  uavg*= em.clocks.pfactor;
-  *umaxp= umax; *uavgp= uavg;
+  em.newest= em.newest== em.nspans? 0: em.newest+ 1;
+  em.history[EM_TRAC][em.newest]= traced;
+  em.history[EM_CRIT][em.newest]= critical;
+  em.history[EM_UMAX][em.newest]= umax;
+  em.history[EM_UAVG][em.newest]= uavg;
 }
 inline static double emTrfCum()
 {
-  return em.history[EM_TRAC][em.nspans]- em.history[EM_CRIT][em.nspans]> 1.0e-12?
-         em.history[EM_CRIT][em.nspans]/ em.history[EM_TRAC][em.nspans]: 1.0;
+  return emNewest(EM_TRAC)- emNewest(EM_CRIT)> 1.0e-12?
+         emNewest(EM_CRIT)/ emNewest(EM_TRAC): 1.0;
 }
 inline static double emSerCum()
 {
-  return em.history[EM_CRIT][em.nspans]- em.history[EM_UMAX][em.nspans]> 1.0e-12?
-         em.history[EM_UMAX][em.nspans]/ em.history[EM_CRIT][em.nspans]: 1.0;
+  return emNewest(EM_CRIT)- emNewest(EM_UMAX)> 1.0e-12?
+         emNewest(EM_UMAX)/ emNewest(EM_CRIT): 1.0;
 }
 inline static double emLbeCum()
 {
-  return em.history[EM_UMAX][em.nspans]- em.history[EM_UAVG][em.nspans]> 1.0e-12?
-         em.history[EM_UAVG][em.nspans]/ em.history[EM_UMAX][em.nspans]: 1.0;
+  return emNewest(EM_UMAX)- emNewest(EM_UAVG)> 1.0e-12?
+         emNewest(EM_UAVG)/ emNewest(EM_UMAX): 1.0;
 }
 inline static double emTrfLoc()
 {
-  const double t= em.history[EM_TRAC][em.nspans]- em.history[EM_TRAC][0];
-  const double c= em.history[EM_CRIT][em.nspans]- em.history[EM_CRIT][0];
+  const double t= emNewest(EM_TRAC)- emOldest(EM_TRAC);
+  const double c= emNewest(EM_CRIT)- emOldest(EM_CRIT);
   return t- c> 1.0e-12? c/ t: 1.0;
 }
 inline static double emSerLoc()
 {
-  const double c= em.history[EM_CRIT][em.nspans]- em.history[EM_CRIT][0];
-  const double m= em.history[EM_UMAX][em.nspans]- em.history[EM_UMAX][0];
+  const double c= emNewest(EM_CRIT)- emOldest(EM_CRIT);
+  const double m= emNewest(EM_UMAX)- emOldest(EM_UMAX);
   return c- m> 1.0e-12? m/ c: 1.0;
 }
 inline static double emLbeLoc()
 {
-  const double m= em.history[EM_UMAX][em.nspans]- em.history[EM_UMAX][0];
-  const double a= em.history[EM_UAVG][em.nspans]- em.history[EM_UAVG][0];
+  const double m= emNewest(EM_UMAX)- emOldest(EM_UMAX);
+  const double a= emNewest(EM_UAVG)- emOldest(EM_UAVG);
   /* if(m< a) { m= a; } */
   return m- a> 1.0e-12? a/ m: 1.0;
 }
-inline static void emOutput()
+inline static void emWrite(double elapsed, double traced, double critical,
+                           double umax, double uavg)
 {
   /* input times are in ns */
   const double factor= 1.0e-9;  /* ns to s */
-  const double elapsed= em.clocks.elapsed* factor;
-  const double traced= em.clocks.traced* factor;
-  const double critical= em.clocks.critical* factor;
-  double umax= 0.0, uavg= 0.0; emUsefuls(&umax, &uavg);
+  elapsed*= factor; traced*= factor; critical*= factor;
   umax*= factor; uavg*= factor;
 
   fprintf(em.fp, "%.9e %.9e %.9e %.9e %.9e", elapsed, traced, critical, umax,
@@ -127,48 +108,26 @@ inline static void emOutput()
   fprintf(em.fp, " %.9e %.9e %.9e\n", emLbeLoc(), emSerLoc(),
           emTrfLoc()); /* 9 10 11 */
 }
-inline static void emInit(const int np)
+inline static void emInit(const int rank, const bool several)
 {
-  em.fp= emFileOpen();
+  em.fp= emFileOpen(rank, several);
   fprintf(em.fp, "%15s %15s %15s %15s %15s %15s %15s %15s %15s %15s %15s\n",
           "#elapsed-1", "traced-2", "ideal-3",
           "max-useful-4", "avg-useful-5", "cum-load-bal-6", "cum-ser-eff-7",
           "cum-xfer-eff-8",
           "loc-load-bal-9", "loc-ser-eff-10", "loc-xfer-eff-11");
   em.nspans= GlOpts.evt_mon.nevts_report;
+  em.newest= em.nspans;
   em.history[0]= (double *) malloc(sizeof(double)* (em.nspans+ 1)* EM_NCOMPS);
   memset(em.history[0], 0, sizeof(double)* (em.nspans+ 1)* EM_NCOMPS);
   for(int i= 1; i< EM_NCOMPS; ++i) {
     em.history[i]= em.history[i- 1]+ (em.nspans+ 1);
   }
 
-  em.clocks.elapsed= 0.0;
-  em.clocks.traced= 0.0;
-  em.clocks.critical= 0.0;
-
-  em.clocks.np= np;
-  em.clocks.pfactor= 1.0/ ((double) np);
-
-  em.clocks.onSince= (double *) malloc(sizeof(double)* np);
-  memset(em.clocks.onSince, 0, sizeof(double)* np);
-
-  em.clocks.useful= (double *) malloc(sizeof(double)* np);
-  memset(em.clocks.useful, 0, sizeof(double)* np);
-
-  em.clocks.curr.since= (double *) malloc(sizeof(double)* np);
-  memset(em.clocks.curr.since, 0, sizeof(double)* np);
-
-  em.clocks.curr.state= (int *) malloc(sizeof(int)* np);
-  memset(em.clocks.curr.state, 0, sizeof(int)* np);
-
-  emOutput();
+  emWrite(0.0, 0.0, 0.0, 0.0, 0.0);
 }
 inline static void emFinalize()
 {
-  FREE_IF(em.clocks.curr.state);
-  FREE_IF(em.clocks.curr.since);
-  FREE_IF(em.clocks.useful);
-  FREE_IF(em.clocks.onSince);
   FREE_IF(em.history[0]);
   memset(em.history, 0, sizeof(double *)* EM_NCOMPS);
   if(NULL!= em.fp) {
@@ -183,259 +142,1031 @@ inline static void emFinalize()
 #undef EM_CRIT
 #undef EM_TRAC
 
-void DoMonitoringEventBased()
+#define SHM_ALLOC(x, n) ((x)= ShmAlloc(sizeof(*(x))* (n)))
+#define SHM_FREE(x, n) do { ShmFree((x), sizeof(*(x))* (n)); (x)= NULL; } while(0)
+
+/* one file per window length if there are more than one */
+inline static FILE *wmFileOpen(const double winLen, const char *const ext,
+                               const char *const mode)
 {
-  const int np= TraceGetNumProcs();
-  emInit(np);
-  const int r= GlOpts.evt_mon.rank;
-  double *const useful= em.clocks.useful;
-  int *const state= em.clocks.curr.state;
-  double *const since= em.clocks.curr.since;
-  for(TraceResetIterEvts(); TraceRemainEvts(); TraceIncrIterEvts()) {
-    const double t= TraceGetCurrEvtAt();
-    const int e= TraceGetCurrEvtId();
-    const int p= TraceGetCurrEvtProc();
-    if(p== r) {                 /* useful + critical for this rank */
-      const double delt= t- since[p];
-      em.clocks.elapsed+= delt;
-      if(em.clocks.onSince[p]> -0.1) {
-        em.clocks.traced+= delt;
-      }
+  const int len= strlen(GlOpts.filename)+ 32;
+  char *fn= (char *) malloc(sizeof(char)* len);
+  if(GlOpts.win_mon.nwin_lens> 1&& NULL== GlOpts.win_mon.adapt) {
+    snprintf(fn, len, "%s.wm.%.0lf.%s", GlOpts.filename, winLen, ext);
+  } else {
+    snprintf(fn, len, "%s.wm.%s", GlOpts.filename, ext);
+  }
 
-      if(0== e) {               /* something (MPI/special) -> useful, this is a point */
-        if(TraceGetCurrEvtCrit()> 0.1) {
-          em.clocks.critical= TraceGetCurrEvtCrit();
-        }
-        for(int ip= 0; ip< np; ++ip) {
-          if(0== state[ip]) {
-            useful[ip]+= t- since[ip];
-          }
-          since[ip]= t;
-        }
-        emOutput();
-      } else {                  /* useful -> something(MPI/special) */
-        if(true|| 0== state[p]) {
-          useful[p]+= delt;
-          em.clocks.critical+= delt;
-        }
-        since[p]= t;
-        state[p]= e;
-      }
-    } else {                    /* just usefuls for these ranks */
-      if(0== state[p]) {
-        useful[p]+= t- since[p];
-      }
-      since[p]= t;
-      state[p]= e;
-    }
+  FILE *fp= fopen(fn, mode);
+  FREE_IF(fn);
+  return fp;
+}
+/* traffic columns: #messages and bytes sent per protocol, then #collectives
+ * per comm (1-based, as in the trace) of those listed
+ */
+#define WM_NP2P (2* MSG_NUM_PROTOS)
+inline static void wmHeader(FILE *const fp, const int *const comms,
+                            const int ncomms)
+{
+  static const char *const protos[MSG_NUM_PROTOS]= {
+    "inst", "nblk", "eager", "rdvz"
+  };
+  fprintf(fp, "%15s %15s %15s %15s %15s %15s %15s %15s",
+          "#elapsed-1", "max-ideal-2", "avg-ideal-3", "max-useful-4", "avg-useful-5",
+          "elapsed-loc-6", "ideal-loc-7", "min-nevts-8");
+  char name[32];
+  int col= 9;
+  for(int i= 0; i< WM_NP2P; ++i, ++col) {
+    snprintf(name, sizeof(name), "%s-%s-%d", i< MSG_NUM_PROTOS? "msgs": "bytes",
+             protos[i% MSG_NUM_PROTOS], col);
+    fprintf(fp, " %15s", name);
+  }
+  for(int i= 0; i< ncomms; ++i, ++col) {
+    snprintf(name, sizeof(name), "colls-c%d-%d", comms[i]+ 1, col);
+    fprintf(fp, " %15s", name);
   }
-  emFinalize();
+  fprintf(fp, "\n");
 }
+#define WM_CMAX 0
+#define WM_CAVG 1
+#define WM_UMAX 2
+#define WM_UAVG 3
+#define WM_ELAP 4
+#define WM_CRIT 5
+#define WM_NCOMPS (WM_CRIT+1)
 
-inline static FILE *wmFileOpen()
+/* moving average of the window columns: simple over the last nwins windows,
+ * as running sums over a ring, or exponential with the weight ema of the
+ * newest window. The efficiencies are ratios of the averaged columns.
+ */
+typedef struct {
+  double *ring;                 /* len= nwins* WM_NCOMPS */
+  double sum[WM_NCOMPS];
+  double ema;
+  int nwins;
+  int nfilled;
+  int newest;
+} WmSmooth;
+
+static void wmSmoothInit(WmSmooth *const sm)
 {
-  const int len= strlen(GlOpts.filename)+ 8;
-  char *fn= (char *) malloc(sizeof(char)* len);
-  memset(fn, 0, sizeof(char)* len);
-  memcpy(fn, GlOpts.filename, sizeof(char)* (len- 8));
-  /* printf("fn0= \"%s\"\n", fn); */
-  strcat(fn, ".wm.dat");
-  /* printf("fn1= \"%s\", fn[-3]= '%c', fn[-2]= '%c', fn[-1]= '%c'\n", fn, fn[len- 3], fn[len- 2], fn[len- 1]); */
+  memset(sm, 0, sizeof(WmSmooth));
+  sm->ema= GlOpts.win_mon.ema;
+  sm->nwins= sm->ema> 0.0? 1: MAX(GlOpts.win_mon.nwins_sma, 1);
+  sm->newest= sm->nwins- 1;
+  sm->ring= (double *) malloc(sizeof(double)* sm->nwins* WM_NCOMPS);
+  memset(sm->ring, 0, sizeof(double)* sm->nwins* WM_NCOMPS);
+}
+static void wmSmooth(WmSmooth *const sm, double *const x)
+{
+  if(sm->ema> 0.0) {
+    for(int i= 0; i< WM_NCOMPS; ++i) {
+      sm->sum[i]= sm->nfilled> 0? sm->ema* x[i]+ (1.0- sm->ema)* sm->sum[i]: x[i];
+      x[i]= sm->sum[i];
+    }
+    sm->nfilled= 1;
+    return;
+  }
+  if(sm->nwins< 2) {
+    return;
+  }
 
-  FILE *fp= fopen(fn, "w");
-  FREE_IF(fn);
-  return fp;
+  sm->newest= sm->newest== sm->nwins- 1? 0: sm->newest+ 1;
+  double *const slot= sm->ring+ sm->newest* WM_NCOMPS;
+  if(sm->nfilled== sm->nwins) {  /* the oldest leaves */
+    for(int i= 0; i< WM_NCOMPS; ++i) {
+      sm->sum[i]-= slot[i];
+    }
+  } else {
+    ++(sm->nfilled);
+  }
+  const double pfactor= 1.0/ ((double) sm->nfilled);
+  for(int i= 0; i< WM_NCOMPS; ++i) {
+    slot[i]= x[i];
+    sm->sum[i]+= x[i];
+    x[i]= sm->sum[i]* pfactor;
+  }
 }
-void DoMonitoringWindowed()
+
+/* one window from the useful and critical time of each rank in it, and its
+ * traffic (not smoothed)
+ */
+static void wmWrite(FILE *const fp, WmSmooth *const sm, const double tMin,
+                    const double tMax, const double *const useful,
+                    const double *const critical, const double nevtsmin,
+                    const int np, const long *const traffic, const int ncols)
 {
-  const int np= TraceGetNumProcs();
+  const double pfactor= 1.0/ ((double) np);
+  double uavg= 0.0, umax= 0.0, cavg= 0.0, cmax= 0.0;
+  for(int ip= 0; ip< np; ++ip) {
+    const double u= useful[ip];
+    uavg+= u;
+    umax= MAX(u, umax);
+
+    const double c= critical[ip];
+    cavg+= c;
+    cmax= MAX(c, cmax);
+  }
+  uavg*= pfactor;
+  cavg*= pfactor;
+
+  double crit= cmax;
+  if(crit< umax) {
+    Debug1("Forced correction: critical < max-useful at bin [%.0lf, %.0lf)\n",
+           tMin, tMax);
+    crit= umax;
+  }
+
+  if(crit> tMax- tMin) {
+    Debug1("Forced correction: critical > elapsed at bin [%.0lf, %.0lf)\n",
+           tMin, tMax);
+    crit= tMax- tMin;
+  }
 
+  double x[WM_NCOMPS]= { cmax, cavg, umax, uavg, tMax- tMin, crit };
+  wmSmooth(sm, x);
+  fprintf(fp, "%.9e %.9e %.9e %.9e %.9e %.9e %.9e %.9e",
+          tMax, x[WM_CMAX], x[WM_CAVG], x[WM_UMAX], x[WM_UAVG], x[WM_ELAP],
+          x[WM_CRIT], nevtsmin);
+  for(int i= 0; i< ncols; ++i) {
+    fprintf(fp, " %ld", traffic[i]);
+  }
+  fprintf(fp, "\n");
+}
+
+#undef WM_NCOMPS
+#undef WM_CRIT
+#undef WM_ELAP
+#undef WM_UAVG
+#undef WM_UMAX
+#undef WM_CAVG
+#undef WM_CMAX
+
+/* Windowed monitor as a pyramid: the useful and critical time and #events of
+ * each rank are accumulated once into the finest bins, the greatest common
+ * divisor of the window lengths, and turned into prefix sums. A window of any
+ * length that is a multiple of the finest is then the difference of two rows.
+ * Events are handed over rank by rank in the order of their events, by the
+ * replay (online) or after it. The state is in shared memory, as the ranks may
+ * be replayed by forked workers.
+ * The traffic of a window is not per rank: messages are counted by the sender
+ * at the end of the send, and collectives by the lowest replayed member of
+ * their comm with collectives on it, as it enters. Its bins are summed up once all ranks are done.
+ */
+static struct {
   struct {
-    double *since;              /* elapsed */
+    double *since;
     double *crit;
     int *state;
-  } last= { NULL, NULL };
+    long *bin;                  /* of since */
+    long *coll;                 /* collectives entered */
+  } last;                       /* len= #procs */
+  double *bounds;               /* len= #bins+ 1 */
+  double *useful;               /* len= (#bins+ 1)* #procs, row k+ 1 is bin k */
+  double *critical;
+  double *nevts;
+  long *traffic;                /* len= (#bins+ 1)* #cols, row k+ 1 is bin k */
+  int *colOf;                   /* len= #comms; -1: no collective */
+  int *counter;                 /* len= #comms; the member counting them */
+  int *comms;                   /* len= #cols- WM_NP2P */
+  int ncols;
+  double step;
+  long nbins;
+  int np;
+} wm= { { NULL, NULL, NULL, NULL, NULL }, NULL, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, 0, 0.0, 0, 0 };
 
-  struct {
-    struct {
-      double *critical;
-      double *useful;
-    } prev;
+inline static long gcd(long a, long b)
+{
+  while(b> 0) {
+    const long r= a% b;
+    a= b; b= r;
+  }
+  return a;
+}
+/* the greatest common divisor of the window lengths, unless it makes more
+ * than WM_MAX_STEPS bins per shortest window: then the shortest
+ */
+#define WM_MAX_STEPS 16
+static double wmFinestStep()
+{
+  const double *const lens= GlOpts.win_mon.win_len;
+  double lmin= lens[0];
+  long g= llround(lens[0]);
+  for(int i= 1; i< GlOpts.win_mon.nwin_lens; ++i) {
+    lmin= MIN(lens[i], lmin);
+    g= gcd(g, llround(lens[i]));
+  }
+  if(g< 1|| (double) g* WM_MAX_STEPS< lmin) {
+    Error("Window lengths have no common step of at least 1/%d of the"
+          " shortest, using steps of %.0lf ns\n", WM_MAX_STEPS, lmin);
+    for(int i= 0; i< GlOpts.win_mon.nwin_lens; ++i) {
+      const double len= MAX(1, llround(lens[i]/ lmin))* lmin;
+      ErrorIf(!SameTime(len, lens[i]), "  window of %.0lf ns is %.0lf ns\n",
+              lens[i], len);
+    }
+    return lmin;
+  }
+  return (double) g;
+}
+#undef WM_MAX_STEPS
 
-    struct {
-      double *critical;
-      double *useful;
-    } curr;
+/* Adaptive windows, from --wmon-adapt: "events:n" closes a window at every
+ * n-th event over all ranks, "colls[:k]" as every k-th collective spanning
+ * all ranks is left by the last of them. The bounds are sorted, from t0 to t1.
+ */
+static long wmAdaptiveBounds(const char *const spec, const double t0,
+                             const double t1, double **boundsp)
+{
+  const int np= TraceGetNumProcs();
+  long n= 0, every= 1;
+  double *ends= NULL;
+  if(1== sscanf(spec, "events:%ld", &every)&& every> 0) {
+    /* the events array is in read order, time-ordered only per rank */
+    const long nevts= TraceGetNumEvts();
+    double *at= (double *) malloc(sizeof(double)* MAX(nevts, 1));
+    for(long i= 0; i< nevts; ++i) {
+      at[i]= TraceGetEvtAt(i);
+    }
+    qsort(at, nevts, sizeof(double), CmpDoubles);
+    n= nevts/ every;
+    ends= (double *) malloc(sizeof(double)* (n+ 1));
+    for(long i= 0; i< n; ++i) {
+      ends[i]= at[(i+ 1)* every- 1];
+    }
+    FREE_IF(at);
+  } else if(0== strncmp("colls", spec, 5)) {
+    if(':'== spec[5]) {
+      every= MAX(atol(spec+ 6), 1);
+    }
+    long ncolls= 0;
+    for(int ip= 0; ip< np; ++ip) {
+      ncolls= MAX(TraceGetNumProcColls(ip), ncolls);
+    }
+    ends= (double *) malloc(sizeof(double)* (ncolls+ 1));
+    memset(ends, 0, sizeof(double)* (ncolls+ 1));
+    for(int ip= 0; ip< np; ++ip) {
+      long k= 0;
+      for(long ix= 0; ix< TraceGetNumProcColls(ip); ++ix) {
+        const int c= TraceGetCommProcColl(ip, ix);
+        if(c< 0|| TraceGetCommSize(c)< np) {
+          continue;
+        }
+        ends[k]= MAX(TraceGetAtProcColl(ip, ix, 1), ends[k]);
+        ++k;
+      }
+      n= MAX(k, n);
+    }
+    long m= 0;
+    for(long i= every- 1; i< n; i+= every) {
+      ends[m++]= ends[i];
+    }
+    n= m;
+    qsort(ends, n, sizeof(double), CmpDoubles);
+  } else {
+    Error("Invalid adaptive monitoring windows \"%s\"; using one\n", spec);
+  }
 
-    double *nevts;
+  double *bounds= (double *) malloc(sizeof(double)* (n+ 2));
+  long nbins= 0;
+  bounds[0]= t0;
+  for(long i= 0; i< n; ++i) {
+    if(ends[i]> bounds[nbins]&& ends[i]< t1) {
+      bounds[++nbins]= ends[i];
+    }
+  }
+  bounds[++nbins]= t1;
+  ErrorIf(nbins< n+ 1, "Adaptive monitoring windows \"%s\": %ld of %ld have no"
+          " length, merged into the next\n", spec, n+ 1- nbins, n+ 1);
+  FREE_IF(ends);
 
-    double tMin;
-    double tMax;
-    double step;
-  } bin= { { NULL, NULL }, { NULL, NULL }, NULL, 0.0, 0.0, 0.0 };
+  *boundsp= bounds;
+  return nbins;
+}
 
-  last.since= (double *) malloc(sizeof(double)* np);
-  memset(last.since, 0, sizeof(double)* np);
+/* elapsed, or ideal till the largest critical time */
+static void wmAxis(double *const t0p, double *const t1p)
+{
+  *t0p= TraceGetProgStartTimeMin();
+  *t1p= TraceGetProgEndTimeMax();
+  if(GlOpts.win_mon.ideal) {
+    double t1= *t0p;
+    for(long i= 0; i< TraceGetNumEvts(); ++i) {
+      t1= MAX(TraceGetEvtCrit(i), t1);
+    }
+    *t1p= t1;
+  }
+}
+/* a column per comm with collectives among the replayed ranks, counted by
+ * the lowest of them; the comms hold only the replayed ranks, renumbered
+ */
+static void wmTrafficInit(const int np)
+{
+  const long ncomms= TraceGetNumComms();
+  wm.colOf= (int *) malloc(sizeof(int)* MAX(ncomms, 1));
+  memset(wm.colOf, 0xff, sizeof(int)* MAX(ncomms, 1));
+  wm.counter= (int *) malloc(sizeof(int)* MAX(ncomms, 1));
+  memset(wm.counter, 0xff, sizeof(int)* MAX(ncomms, 1));
+  for(int ip= 0; ip< np; ++ip) {
+    for(long ix= 0; ix< TraceGetNumProcColls(ip); ++ix) {
+      const int c= TraceGetCommProcColl(ip, ix);
+      if(c>= 0&& c< ncomms&& wm.counter[c]< 0) {
+        wm.colOf[c]= 0;
+        wm.counter[c]= ip;
+      }
+    }
+  }
+  wm.comms= (int *) malloc(sizeof(int)* MAX(ncomms, 1));
+  wm.ncols= WM_NP2P;
+  for(int c= 0; c< ncomms; ++c) {
+    if(0== wm.colOf[c]) {
+      wm.comms[wm.ncols- WM_NP2P]= c;
+      wm.colOf[c]= wm.ncols++;
+    }
+  }
+  SHM_ALLOC(wm.traffic, (wm.nbins+ 1)* wm.ncols);
+  SHM_ALLOC(wm.last.coll, np);
+}
+static void wmInit(const int np)
+{
+  double t0= 0.0, t1= 0.0;
+  wmAxis(&t0, &t1);
+  wm.np= np;
+  if(NULL!= GlOpts.win_mon.adapt) {
+    wm.step= 0.0;
+    wm.nbins= wmAdaptiveBounds(GlOpts.win_mon.adapt, t0, t1, &wm.bounds);
+  } else {
+    wm.step= wmFinestStep();
+    wm.nbins= (long) ceil((t1- t0)/ wm.step);
+    wm.bounds= (double *) malloc(sizeof(double)* (wm.nbins+ 1));
+    wm.bounds[0]= t0;
+    for(long k= 0; k< wm.nbins; ++k) {
+      wm.bounds[k+ 1]= MIN(wm.bounds[k]+ wm.step, t1);
+    }
+  }
+  wmTrafficInit(np);
+  const double mib= (3.0* sizeof(double)* np+ sizeof(long)* wm.ncols)*
+                    (wm.nbins+ 1)/ (1 << 20);
+  Log1("Windowed monitoring: %ld bins, %.1lf MiB\n", wm.nbins, mib);
+  ErrorIf(mib> 1024.0, "Windowed monitoring: %ld bins of %d ranks take %.1lf"
+          " MiB\n", wm.nbins, np, mib);
+  SHM_ALLOC(wm.useful, (wm.nbins+ 1)* np);
+  SHM_ALLOC(wm.critical, (wm.nbins+ 1)* np);
+  SHM_ALLOC(wm.nevts, (wm.nbins+ 1)* np);
+  SHM_ALLOC(wm.last.since, np);
+  SHM_ALLOC(wm.last.crit, np);
+  SHM_ALLOC(wm.last.state, np);
+  SHM_ALLOC(wm.last.bin, np);
+  for(int ip= 0; ip< np; ++ip) {
+    wm.last.since[ip]= wm.last.crit[ip]= t0;
+    wm.last.state[ip]= -1;
+  }
+}
+/* spreads the time since the last event of a rank over the bins till t:
+ * useful as is, the critical time of anything else as early as possible
+ */
+static void wmSpread(const int p, const double t, const double crit)
+{
+  const int np= wm.np;
+  const bool useful= 0== wm.last.state[p];
+  double s= wm.last.since[p];
+  double rest= crit> 0.1? crit- wm.last.crit[p]: 0.0;
+  long k= wm.last.bin[p];
+  for(; k< wm.nbins- 1&& t> wm.bounds[k+ 1]; ++k) {
+    const double len= wm.bounds[k+ 1]- s;
+    if(useful) {
+      wm.useful[(k+ 1)* np+ p]+= len;
+      wm.critical[(k+ 1)* np+ p]+= len;
+    } else {
+      const double c= rest> len? len: rest;
+      wm.critical[(k+ 1)* np+ p]+= c;
+      rest-= c;
+    }
+    s= wm.bounds[k+ 1];
+  }
+  if(useful) {
+    wm.useful[(k+ 1)* np+ p]+= t- s;
+    wm.critical[(k+ 1)* np+ p]+= t- s;
+  } else {
+    wm.critical[(k+ 1)* np+ p]+= rest;
+  }
+  wm.last.bin[p]= k;
+}
+static void wmEvt(const int p, const double t, const int e, const double crit)
+{
+  if(0!= wm.last.state[p]&& crit<= 0.1) {
+    Error("%d: at %.0lf, critical is %.0lf (%d -> %d)\n", p, t, crit,
+          wm.last.state[p], e);
+  }
+  wmSpread(p, t, crit);
+  wm.nevts[(wm.last.bin[p]+ 1)* wm.np+ p]+= 1.0;
+  wm.last.since[p]= t;
+  if(crit> 0.1) {
+    wm.last.crit[p]= crit;
+  }
+  wm.last.state[p]= e;
+}
+/* the traffic at event ix of rank p, in the bin it was placed */
+static void wmTraffic(const int p, const long ix)
+{
+  long *const row= wm.traffic+ (wm.last.bin[p]+ 1)* wm.ncols;
+  for(IndexList *ixs= TraceGetProcEvtSends(p, 1, ix); NULL!= ixs;
+      ixs= ixs->next) {
+    const long gid= TraceGetProcSendGid(p, ixs->i);
+    const int proto= TraceGetMsgProto(gid);
+    ShmAddLong(row+ proto, 1);
+    ShmAddLong(row+ MSG_NUM_PROTOS+ proto, llround(TraceGetMsgSize(gid)));
+  }
 
-  last.crit= (double *) malloc(sizeof(double)* np);
-  memset(last.crit, 0, sizeof(double)* np);
+  const double at= TraceGetAtProcEvt(p, ix);
+  long *const kc= wm.last.coll+ p;
+  for(; *kc< TraceGetNumProcColls(p)&& TraceGetAtProcColl(p, *kc, 0)<= at;
+      ++(*kc)) {
+    const int c= TraceGetCommProcColl(p, *kc);
+    if(c>= 0&& c< TraceGetNumComms()&& p== wm.counter[c]) {
+      ShmAddLong(row+ wm.colOf[c], 1);
+    }
+  }
+}
+/* Heatmap of the windows, binary in host byte order: "CTHM", then int32
+ * version (1), #ranks and bytes per value (4: float32 ns, 1: uint8 share of
+ * the window as 0-255). A row per window: float64 start and end in ns, then
+ * the useful time of each rank, then its critical time. Rows are written one at
+ * a time from the bins, which are per rank already.
+ */
+static FILE *wmHeatmapOpen(const double winLen, const int np)
+{
+  FILE *fp= wmFileOpen(winLen, "hm", "wb");
+  if(NULL== fp) {
+    Error("Cannot open the heatmap file\n");
+    return NULL;
+  }
+  const int32_t header[3]= { 1, np, GlOpts.win_mon.heatmap };
+  fwrite("CTHM", 1, 4, fp);
+  fwrite(header, sizeof(int32_t), 3, fp);
+  return fp;
+}
+static void wmHeatmapRow(FILE *const fp, void *const row, const double tMin,
+                         const double tMax, const double *const useful,
+                         const double *const critical, const int np)
+{
+  const double t[2]= { tMin, tMax };
+  fwrite(t, sizeof(double), 2, fp);
+  if(1== GlOpts.win_mon.heatmap) {
+    uint8_t *const x= (uint8_t *) row;
+    const double scale= tMax> tMin? 255.0/ (tMax- tMin): 0.0;
+    for(int ip= 0; ip< np; ++ip) {
+      x[ip]= (uint8_t) lround(MIN(MAX(useful[ip]* scale, 0.0), 255.0));
+      x[np+ ip]= (uint8_t) lround(MIN(MAX(critical[ip]* scale, 0.0), 255.0));
+    }
+    fwrite(x, sizeof(uint8_t), 2* np, fp);
+  } else {
+    float *const x= (float *) row;
+    for(int ip= 0; ip< np; ++ip) {
+      x[ip]= (float) useful[ip];
+      x[np+ ip]= (float) critical[ip];
+    }
+    fwrite(x, sizeof(float), 2* np, fp);
+  }
+}
 
-  last.state= (int *) malloc(sizeof(int)* np);
-  memset(last.state, 0, sizeof(int)* np);
+/* windows of m bins; unless adaptive, those with too few events on any rank
+ * are merged with the next ones
+ */
+static void wmOutput(const long m, const double winLen)
+{
+  const int np= wm.np;
+  const bool merge= NULL== GlOpts.win_mon.adapt;
+  double *useful= (double *) malloc(sizeof(double)* np* 2);
+  double *const critical= useful+ np;
+  const int ncols= wm.ncols;
+  long *traffic= (long *) malloc(sizeof(long)* ncols);
 
-  bin.prev.critical= (double *) malloc(sizeof(double)* np);
-  memset(bin.prev.critical, 0, sizeof(double)* np);
+  WmSmooth sm;
+  wmSmoothInit(&sm);
 
-  bin.prev.useful= (double *) malloc(sizeof(double)* np);
-  memset(bin.prev.useful, 0, sizeof(double)* np);
+  FILE *fp= wmFileOpen(winLen, "dat", "w");
+  wmHeader(fp, wm.comms, ncols- WM_NP2P);
+  FILE *hm= GlOpts.win_mon.heatmap> 0? wmHeatmapOpen(winLen, np): NULL;
+  void *row= NULL!= hm? malloc(sizeof(float)* 2* np): NULL;
+  const double nevts_threshold= sqrt((double) np);
+  long kMin= 0;
+  for(long k= MIN(m, wm.nbins); kMin< wm.nbins; k= MIN(k+ m, wm.nbins)) {
+    const double tMax= wm.bounds[k];
+    double nevtsmin= DBL_MAX;
+    for(int ip= 0; ip< np; ++ip) {
+      nevtsmin= MIN(wm.nevts[k* np+ ip]- wm.nevts[kMin* np+ ip], nevtsmin);
+    }
+    if(merge&& nevtsmin< nevts_threshold&& k< wm.nbins) {
+      continue;
+    }
+    for(int ip= 0; ip< np; ++ip) {
+      useful[ip]= wm.useful[k* np+ ip]- wm.useful[kMin* np+ ip];
+      critical[ip]= wm.critical[k* np+ ip]- wm.critical[kMin* np+ ip];
+    }
+    for(int i= 0; i< ncols; ++i) {
+      traffic[i]= wm.traffic[k* ncols+ i]- wm.traffic[kMin* ncols+ i];
+    }
+    wmWrite(fp, &sm, wm.bounds[kMin], tMax, useful, critical, nevtsmin, np,
+            traffic, ncols);
+    if(NULL!= hm) {
+      wmHeatmapRow(hm, row, wm.bounds[kMin], tMax, useful, critical, np);
+    }
+    kMin= k;
+  }
+  fclose(fp); fp= NULL;
+  if(NULL!= hm) {
+    fclose(hm); hm= NULL;
+  }
 
-  bin.curr.critical= (double *) malloc(sizeof(double)* np);
-  memset(bin.curr.critical, 0, sizeof(double)* np);
+  FREE_IF(row);
+  FREE_IF(sm.ring);
+  FREE_IF(traffic);
+  FREE_IF(useful);
+}
+/* the tails of the ranks p0..p1-1, and their prefix sums */
+static void wmSettle(const int p0, const int p1)
+{
+  const int np= wm.np;
+  const double t1= GlOpts.win_mon.ideal? wm.bounds[wm.nbins]: TraceGetProgEndTimeMax();
+  for(int ip= p0; ip< p1; ++ip) {
+    if(0!= wm.last.state[ip]) {
+      continue;
+    }
+    const long n= TraceGetNumProcEvts(ip);
+    if(GlOpts.win_mon.ideal&& n> 0) { /* the useful tail of the rank */
+      const double tail= TraceGetProcEndTime(ip)- TraceGetAtProcEvt(ip, n- 1);
+      wmSpread(ip, MIN(wm.last.since[ip]+ MAX(tail, 0.0), t1), 0.0);
+    } else {
+      wmSpread(ip, t1, 0.0);
+    }
+  }
 
-  bin.curr.useful= (double *) malloc(sizeof(double)* np);
-  memset(bin.curr.useful, 0, sizeof(double)* np);
+  for(long k= 1; k<= wm.nbins; ++k) {
+    for(int ip= p0; ip< p1; ++ip) {
+      wm.useful[k* np+ ip]+= wm.useful[(k- 1)* np+ ip];
+      wm.critical[k* np+ ip]+= wm.critical[(k- 1)* np+ ip];
+      wm.nevts[k* np+ ip]+= wm.nevts[(k- 1)* np+ ip];
+    }
+  }
+}
+/* writes the windows unless output is false, and frees them */
+static void wmFinalize(const bool output)
+{
+  const int np= wm.np;
+  const int ncols= wm.ncols;
+  for(long k= 1; output&& k<= wm.nbins; ++k) {
+    for(int i= 0; i< ncols; ++i) {
+      wm.traffic[k* ncols+ i]+= wm.traffic[(k- 1)* ncols+ i];
+    }
+  }
+  if(!output) {
+    ;
+  } else if(NULL!= GlOpts.win_mon.adapt) {
+    wmOutput(1, 0.0);
+  } else {
+    for(int i= 0; i< GlOpts.win_mon.nwin_lens; ++i) {
+      const double len= GlOpts.win_mon.win_len[i];
+      wmOutput(MAX(1, llround(len/ wm.step)), len);
+    }
+  }
 
-  bin.nevts= (double *) malloc(sizeof(double)* np);
-  memset(bin.nevts, 0, sizeof(double)* np);
+  SHM_FREE(wm.last.coll, np);
+  SHM_FREE(wm.traffic, (wm.nbins+ 1)* ncols);
+  FREE_IF(wm.comms);
+  FREE_IF(wm.counter);
+  FREE_IF(wm.colOf);
+  SHM_FREE(wm.last.bin, np);
+  SHM_FREE(wm.last.state, np);
+  SHM_FREE(wm.last.crit, np);
+  SHM_FREE(wm.last.since, np);
+  SHM_FREE(wm.nevts, (wm.nbins+ 1)* np);
+  SHM_FREE(wm.critical, (wm.nbins+ 1)* np);
+  SHM_FREE(wm.useful, (wm.nbins+ 1)* np);
+  FREE_IF(wm.bounds);
+}
 
-  const double t0= TraceGetProgStartTimeMin();
-  const double t1= TraceGetProgEndTimeMax();
+/* On the ideal axis, an event is placed at its critical time, or where the
+ * last one was if it has none: a useful burst takes as long as recorded and
+ * anything else as long as its critical time grows.
+ */
+static void wmAccumulate(const int p0, const int p1)
+{
+  const bool ideal= GlOpts.win_mon.ideal;
+  for(int ip= p0; ip< p1; ++ip) {
+    for(long ix= 0; ix< TraceGetNumProcEvts(ip); ++ix) {
+      const double crit= TraceGetCritProcEvt(ip, ix);
+      const double t= !ideal? TraceGetAtProcEvt(ip, ix):
+                      MAX(crit> 0.1? crit: 0.0, wm.last.since[ip]);
+      wmEvt(ip, t, TraceGetIdProcEvt(ip, ix), crit);
+      wmTraffic(ip, ix);
+    }
+  }
+  wmSettle(p0, p1);
+}
+/* The ranks are independent till the windows are written: forked workers
+ * (--workers) take blocks of similar #events, the bins being shared. A block
+ * whose worker cannot be forked is done here. Returns #workers failed.
+ */
+static void wmAccumulateBlock(const int k, const int p0, const int p1,
+                              void *const arg)
+{
+  (void) k; (void) arg;
+  wmAccumulate(p0, p1);
+}
+static int wmAccumulateWorkers(const int nworkers)
+{
+  int *first= (int *) malloc(sizeof(int)* (nworkers+ 1));
+  TracePartitionProcs(nworkers, first);
+  const int nfailed= ShmRunWorkers(nworkers, first, wmAccumulateBlock,
+                                   wmAccumulateBlock, NULL);
+  FREE_IF(first);
+  return nfailed;
+}
 
-  for(int ip= 0; ip< np; ++ip) {
-    bin.curr.critical[ip]= bin.curr.useful[ip]= t0;
-    last.since[ip]= last.crit[ip]= t0; last.state[ip]= -1;
+void DoMonitoringWindowed()
+{
+  const int np= TraceGetNumProcs();
+  wmInit(np);
+  const int nworkers= MIN(GlOpts.sim_opts.nworkers, np);
+  bool complete= true;
+  if(nworkers> 1) {
+    complete= 0== wmAccumulateWorkers(nworkers);
+  } else {
+    wmAccumulate(0, np);
+  }
+  if(!complete) {
+    Error("Windowed monitoring incomplete, nothing written\n");
   }
+  wmFinalize(complete);
+}
 
-  FILE *fp= wmFileOpen();
-  fprintf(fp, "%15s %15s %15s %15s %15s %15s %15s %15s\n",
-          "#elapsed-1", "max-ideal-2", "avg-ideal-3", "max-useful-4", "avg-useful-5",
-          "elapsed-loc-6", "ideal-loc-7", "min-nevts-8");
+/* Event-based monitor of one or more ranks: a sample is taken as a monitored
+ * rank leaves MPI, from its own clocks and the useful time of all ranks till
+ * then. The clocks of a monitored rank need the critical time of its events,
+ * so they are kept as the events are handed over rank by rank, by the replay
+ * (online) or after it. The useful time of all ranks needs only the trace and
+ * is swept once in the order of time over all events and samples, see
+ * emonSweep.
+ */
+typedef struct {
+  double *at;                   /* len= #samples */
+  double *clocks;               /* len= 3* #samples: elapsed, traced, critical */
+  double *useful;               /* len= #samples: of the rank, as it sees it */
+  double *usum;                 /* len= #samples: useful of all ranks */
+  double *umax;
+  long nsamples;
+  long next;                    /* sample */
+  double since;
+  double elapsed;
+  double traced;
+  double critical;
+  double uown;
+  int state;
+  int rank;
+} EmRank;
 
-  bin.step= GlOpts.win_mon.win_len;
-  bin.tMin= t0;
-  TraceResetProcIters();
-  const double pfactor= 1.0/ ((double) np);
-  const double nevts_threshold= sqrt((double) np); /* MIN(128.0,((double) np)); */
-  const long nbins= (long) ceil((t1- t0)/ bin.step);
-  for(long ibin= 0; ibin< nbins; ++ibin) {
-    bin.tMax= MIN(bin.tMin+bin.step, t1);
-    memcpy(bin.prev.critical, bin.curr.critical, sizeof(double)* np);
-    memcpy(bin.prev.useful, bin.curr.useful, sizeof(double)* np);
-    memset(bin.nevts, 0, sizeof(double)* np);
-
-again:
-    /* work till elapsed exceeds end-of-the-bin */
-    for(int ip= 0; ip< np; ++ip) {
-      for(; TraceRemainsProcEvts(ip); TraceIncrIterProcEvts(ip)) {
-        const double t= TraceGetAtCurrProcEvt(ip);
-        if(t> bin.tMax) {
-          break;
-        }
+typedef struct {
+  double at;
+  int mon;
+  long j;
+} EmSample;
 
-        const double delta= t- last.since[ip];
-        if(0== last.state[ip]) { /* leaving useful */
-          bin.curr.critical[ip]+= delta;
-          bin.curr.useful[ip]+= delta;
-        } else {                /* leaving MPI/special */
-          if(TraceGetCritCurrProcEvt(ip)> 0.1) {
-            bin.curr.critical[ip]+= TraceGetCritCurrProcEvt(ip)- last.crit[ip];
-          } else {
-            Error("%d: at %.0lf, critical is %.0lf (%d -> %d)\n", ip,
-                  t, TraceGetCritCurrProcEvt(ip),
-                  last.state[ip], TraceGetIdCurrProcEvt(ip));
-          }
-        }
-        bin.nevts[ip]+= 1.0;
+static struct {
+  EmRank *mon;                  /* len= #monitored ranks */
+  int *monOf;                   /* len= #procs; -1 if not monitored */
+  EmSample *samples;            /* of all monitored ranks, by time */
+  long nsamples;
+  int nmons;
+  int np;
+} emon= { NULL, NULL, NULL, 0, 0, 0 };
 
-        last.since[ip]= t;
-        if(TraceGetCritCurrProcEvt(ip)> 0.1) {
-          last.crit[ip]= TraceGetCritCurrProcEvt(ip);
-        }
-        last.state[ip]= TraceGetIdCurrProcEvt(ip);
+/* from --emon-rank: a rank, a list like "0-3,8" or the members of "comm:c" */
+static void emonSelectRanks(const int np)
+{
+  emon.monOf= (int *) malloc(sizeof(int)* np);
+  for(int ip= 0; ip< np; ++ip) {
+    emon.monOf[ip]= -1;
+  }
+  const char *const spec= GlOpts.evt_mon.ranks;
+  if(NULL== spec) {             /* checked when reading the trace */
+    emon.monOf[GlOpts.evt_mon.rank]= 0;
+  } else if(0== strncmp("comm:", spec, 5)) {
+    const long c= atol(spec+ 5)- 1;
+    if(c< 0|| c>= TraceGetNumComms()) {
+      Error("Invalid communicator for event-based monitoring \"%s\" (%ld comms)\n",
+            spec, TraceGetNumComms());
+    } else {
+      for(int i= 0; i< TraceGetCommSize(c); ++i) {
+        emon.monOf[TraceGetCommRank(c, i)]= 0;
       }
     }
+  } else {
+    TraceMarkRankList(spec, emon.monOf, np);
+  }
 
-    double nevtsmin= DBL_MAX;
-    for(int ip= 0; ip< np; ++ip) {
-      nevtsmin= MIN(bin.nevts[ip], nevtsmin);
+  emon.nmons= 0;
+  for(int ip= 0; ip< np; ++ip) {
+    if(0== emon.monOf[ip]) {
+      emon.monOf[ip]= emon.nmons++;
     }
-#if 1
-    if(nevtsmin< nevts_threshold&& bin.tMax< t1) {
-      ++ibin;
-      bin.tMax= MIN(bin.tMax+bin.step, t1);
-      goto again;
+  }
+  if(emon.nmons< 1) {
+    const int r= MIN(MAX(GlOpts.evt_mon.rank, 0), np- 1);
+    Error("No rank to monitor in \"%s\"; monitoring %d\n", spec, r);
+    emon.monOf[r]= 0;
+    emon.nmons= 1;
+  }
+}
+static int cmpSamples(const void *a, const void *b)
+{
+  const EmSample *const x= (const EmSample *) a;
+  const EmSample *const y= (const EmSample *) b;
+  if(x->at!= y->at) {
+    return x->at< y->at? -1: 1;
+  }
+  return x->mon!= y->mon? x->mon- y->mon: (x->j< y->j? -1: x->j> y->j);
+}
+static void emonInit(const int np)
+{
+  emon.np= np;
+  emonSelectRanks(np);
+  SHM_ALLOC(emon.mon, emon.nmons);
+  emon.nsamples= 0;
+  for(int ip= 0; ip< np; ++ip) {
+    const int m= emon.monOf[ip];
+    if(m< 0) {
+      continue;
     }
-#endif
-
-    /* fill the remaing gap till end-of-the-bin */
-    double tcmax= 0.0, tcmin= DBL_MAX;
-    for(int ip= 0; ip< np; ++ip) {
-      const double tremains= bin.tMax- last.since[ip];
-      switch(last.state[ip]) {
-      case 0:
-        bin.curr.critical[ip]+= tremains;
-        bin.curr.useful[ip]+= tremains;
-        break;
-      default: {
-          if(TraceGetCritCurrProcEvt(ip)> 0.1) {
-            const double delta= TraceGetCritCurrProcEvt(ip)- last.crit[ip];
-            if(delta> tremains) {
-              bin.curr.critical[ip]+= tremains;
-              last.crit[ip]+= tremains;
-            } else {
-              bin.curr.critical[ip]+= delta;
-              last.crit[ip]+= delta;
-            }
-          } else {
-          }
-        }
-        break;
+    EmRank *const mon= emon.mon+ m;
+    mon->rank= ip;
+    for(long ix= 0; ix< TraceGetNumProcEvts(ip); ++ix) {
+      mon->nsamples+= 0== TraceGetIdProcEvt(ip, ix)? 1: 0;
+    }
+    const long n= mon->nsamples;
+    mon->at= (double *) malloc(sizeof(double)* (n+ 1));
+    for(long ix= 0, j= 0; ix< TraceGetNumProcEvts(ip); ++ix) {
+      if(0== TraceGetIdProcEvt(ip, ix)) {
+        mon->at[j++]= TraceGetAtProcEvt(ip, ix);
       }
+    }
+    SHM_ALLOC(mon->clocks, 3* n+ 3);
+    SHM_ALLOC(mon->useful, n+ 1);
+    emon.nsamples+= n;
+  }
 
-      last.since[ip]= bin.tMax;
-      tcmax= MAX(bin.curr.critical[ip], tcmax);
-      tcmin= MIN(bin.curr.critical[ip], tcmin);
+  emon.samples= (EmSample *) malloc(sizeof(EmSample)* (emon.nsamples+ 1));
+  long n= 0;
+  for(int m= 0; m< emon.nmons; ++m) {
+    for(long j= 0; j< emon.mon[m].nsamples; ++j, ++n) {
+      emon.samples[n].at= emon.mon[m].at[j];
+      emon.samples[n].mon= m;
+      emon.samples[n].j= j;
     }
+  }
+  qsort(emon.samples, n, sizeof(EmSample), cmpSamples);
+}
+/* useful + critical of a monitored rank */
+static void emonEvt(const int p, const double t, const int e,
+                    const double crit)
+{
+  if(emon.monOf[p]< 0) {
+    return;
+  }
+  EmRank *const mon= emon.mon+ emon.monOf[p];
+  const double delt= t- mon->since;
+  mon->elapsed+= delt;
+  mon->traced+= delt;
+  if(0== e) {                   /* something (MPI/special) -> useful, this is a point */
+    if(crit> 0.1) {
+      mon->critical= crit;
+    }
+    if(0== mon->state) {
+      mon->uown+= delt;
+    }
+    mon->since= t;
+    const long j= mon->next++;
+    mon->clocks[3* j]= mon->elapsed;
+    mon->clocks[3* j+ 1]= mon->traced;
+    mon->clocks[3* j+ 2]= mon->critical;
+    mon->useful[j]= mon->uown;
+  } else {                      /* useful -> something(MPI/special) */
+    mon->uown+= delt;
+    mon->critical+= delt;
+    mon->since= t;
+    mon->state= e;
+  }
+}
 
-    double uavg= 0.0, umax= 0.0, cavg= 0.0, cmax= 0.0;
-    for(int ip= 0; ip< np; ++ip) {
-      const double u= bin.curr.useful[ip]- bin.prev.useful[ip];
-      uavg+= u;
-      umax= MAX(u, umax);
+/* max over ranks as a tournament tree, -DBL_MAX for none */
+typedef struct {
+  double *v;                    /* len= 2* n, leaves from n */
+  int n;
+} MaxTree;
+
+static void maxTreeInit(MaxTree *const mt, const int np)
+{
+  for(mt->n= 1; mt->n< np; mt->n*= 2) {
+    ;
+  }
+  mt->v= (double *) malloc(sizeof(double)* 2* mt->n);
+  for(int i= 0; i< 2* mt->n; ++i) {
+    mt->v[i]= -DBL_MAX;
+  }
+}
+inline static double maxTreeGet(const MaxTree *const mt, const int p) { return mt->v[mt->n+ p]; }
+inline static double maxTreeTop(const MaxTree *const mt) { return mt->v[1]; }
+static int maxTreeArgTop(const MaxTree *const mt)
+{
+  int i= 1;
+  while(i< mt->n) {
+    i= mt->v[2* i]== mt->v[i]? 2* i: 2* i+ 1;
+  }
+  return i- mt->n;
+}
+static void maxTreeSet(MaxTree *const mt, const int p, const double x)
+{
+  int i= mt->n+ p;
+  mt->v[i]= x;
+  for(i/= 2; i> 0; i/= 2) {
+    mt->v[i]= MAX(mt->v[2* i], mt->v[2* i+ 1]);
+  }
+}
+
+/* Useful time of all ranks at the samples, in the order of time. The useful
+ * time of a rank is settled only when it changes state: at time s it is
+ * settled+ (s- since) while useful and settled otherwise. So the sum over
+ * ranks is kept as sums of both kinds and the #useful ranks, and the max as
+ * two trees, idle ones by settled and useful ones by settled- since: O(log np)
+ * per event and per sample. A monitored rank is left out of its own samples,
+ * as it counts its useful time itself.
+ * The events of the ranks are merged by time, from a tree of the (negated)
+ * time of the next event of each rank: the events of all ranks in the trace
+ * are not in time order once clocks are shifted.
+ */
+static void emonSweep()
+{
+  const int np= emon.np;
+  double *settled= (double *) malloc(sizeof(double)* np);
+  memset(settled, 0, sizeof(double)* np);
+  double *since= (double *) malloc(sizeof(double)* np);
+  memset(since, 0, sizeof(double)* np);
+  int *state= (int *) malloc(sizeof(int)* np);
+  memset(state, 0, sizeof(int)* np);  /* useful from 0 */
+
+  MaxTree idle, busy;
+  maxTreeInit(&idle, np);
+  maxTreeInit(&busy, np);
+  for(int ip= 0; ip< np; ++ip) {
+    maxTreeSet(&busy, ip, 0.0);
+  }
+  double sidle= 0.0, sbusy= 0.0;
+  long nbusy= np;
 
-      const double c= bin.curr.critical[ip]- bin.prev.critical[ip];
-      cavg+= c;
-      cmax= MAX(c, cmax);
+  long *ix= (long *) malloc(sizeof(long)* np);
+  memset(ix, 0, sizeof(long)* np);
+  MaxTree next;
+  maxTreeInit(&next, np);
+  for(int ip= 0; ip< np; ++ip) {
+    if(TraceGetNumProcEvts(ip)> 0) {
+      maxTreeSet(&next, ip, -TraceGetAtProcEvt(ip, 0));
     }
-    uavg*= pfactor;
-    cavg*= pfactor;
+  }
 
-    double crit= cmax;
-    if(crit< umax) {
-      Debug1("Forced correction: critical < max-useful at bin [%.0lf, %.0lf)\n",
-             bin.tMin, bin.tMax);
-      crit= umax;
+  long s= 0;
+  while(s< emon.nsamples) {
+    const bool remain= maxTreeTop(&next)> -DBL_MAX;
+    const int p= remain? maxTreeArgTop(&next): -1;
+    const double t= remain? TraceGetAtProcEvt(p, ix[p]): DBL_MAX;
+    for(; s< emon.nsamples&& emon.samples[s].at< t; ++s) {
+      const EmSample *const x= emon.samples+ s;
+      EmRank *const mon= emon.mon+ x->mon;
+      const int r= mon->rank;
+      const double ur= 0== state[r]? maxTreeGet(&busy, r)+ x->at: maxTreeGet(&idle, r);
+      const double xi= maxTreeGet(&idle, r), xb= maxTreeGet(&busy, r);
+      maxTreeSet(&idle, r, -DBL_MAX);
+      maxTreeSet(&busy, r, -DBL_MAX);
+      const double umax= MAX(maxTreeTop(&idle), maxTreeTop(&busy)+ x->at);
+      maxTreeSet(&idle, r, xi);
+      maxTreeSet(&busy, r, xb);
+      mon->umax[x->j]= MAX(umax, mon->useful[x->j]);
+      mon->usum[x->j]= sidle+ sbusy+ nbusy* x->at- ur+ mon->useful[x->j];
+    }
+    if(!remain) {
+      break;
     }
 
-    if(crit> bin.tMax- bin.tMin) {
-      Debug1("Forced correction: critical > elapsed at bin [%.0lf, %.0lf)\n",
-             bin.tMin, bin.tMax);
-      crit= bin.tMax- bin.tMin;
+    const int e= TraceGetIdProcEvt(p, ix[p]);
+    if(0== state[p]) {
+      sbusy-= settled[p]- since[p];
+      --nbusy;
+      settled[p]+= t- since[p];
+    } else {
+      sidle-= settled[p];
     }
+    since[p]= t;
+    state[p]= e;
+    if(0== e) {
+      sbusy+= settled[p]- since[p];
+      ++nbusy;
+      maxTreeSet(&busy, p, settled[p]- since[p]);
+      maxTreeSet(&idle, p, -DBL_MAX);
+    } else {
+      sidle+= settled[p];
+      maxTreeSet(&idle, p, settled[p]);
+      maxTreeSet(&busy, p, -DBL_MAX);
+    }
+    ++ix[p];
+    maxTreeSet(&next, p, ix[p]< TraceGetNumProcEvts(p)? -TraceGetAtProcEvt(p, ix[p]):
+               -DBL_MAX);
+  }
 
-    fprintf(fp, "%.9e %.9e %.9e %.9e %.9e %.9e %.9e %.9e\n",
-            bin.tMax, cmax, cavg, umax, uavg, bin.tMax- bin.tMin, crit, nevtsmin);
+  FREE_IF(next.v);
+  FREE_IF(ix);
+  FREE_IF(busy.v);
+  FREE_IF(idle.v);
+  FREE_IF(state);
+  FREE_IF(since);
+  FREE_IF(settled);
+}
+static void emonFinalize()
+{
+  for(int m= 0; m< emon.nmons; ++m) {
+    EmRank *const mon= emon.mon+ m;
+    mon->usum= (double *) malloc(sizeof(double)* (mon->nsamples+ 1));
+    mon->umax= (double *) malloc(sizeof(double)* (mon->nsamples+ 1));
+  }
+  emonSweep();
 
-    bin.tMin= bin.tMax;
+  const double pfactor= 1.0/ ((double) emon.np);
+  for(int m= 0; m< emon.nmons; ++m) {
+    EmRank *const mon= emon.mon+ m;
+    const long n= mon->nsamples;
+    emInit(mon->rank, emon.nmons> 1);
+    for(long j= 0; j< n; ++j) {
+      emWrite(mon->clocks[3* j], mon->clocks[3* j+ 1], mon->clocks[3* j+ 2],
+              mon->umax[j], mon->usum[j]* pfactor);
+    }
+    emFinalize();
+
+    FREE_IF(mon->umax);
+    FREE_IF(mon->usum);
+    SHM_FREE(mon->useful, n+ 1);
+    SHM_FREE(mon->clocks, 3* n+ 3);
+    FREE_IF(mon->at);
   }
-  fclose(fp); fp= NULL;
 
-  FREE_IF(bin.nevts);
-  FREE_IF(bin.curr.useful);
-  FREE_IF(bin.curr.critical);
-  FREE_IF(bin.prev.useful);
-  FREE_IF(bin.prev.critical);
-  FREE_IF(last.state);
-  FREE_IF(last.crit);
-  FREE_IF(last.since);
+  FREE_IF(emon.samples);
+  FREE_IF(emon.monOf);
+  SHM_FREE(emon.mon, emon.nmons);
+}
+
+void DoMonitoringEventBased()
+{
+  const int np= TraceGetNumProcs();
+  emonInit(np);
+  for(int ip= 0; ip< np; ++ip) {
+    for(long ix= 0; ix< TraceGetNumProcEvts(ip); ++ix) {
+      emonEvt(ip, TraceGetAtProcEvt(ip, ix), TraceGetIdProcEvt(ip, ix),
+              TraceGetCritProcEvt(ip, ix));
+    }
+  }
+  emonFinalize();
+}
+
+#undef WM_NP2P
+#undef SHM_FREE
+#undef SHM_ALLOC
+
+void MonitorInit(const int np)
+{
+  if(GlOpts.win_mon.enabled) {
+    wmInit(np);
+  }
+  if(GlOpts.evt_mon.enabled) {
+    emonInit(np);
+  }
+}
+/* the critical time of event ix of rank p is fixed */
+void MonitorEvt(const int p, const long ix, const double crit)
+{
+  const double t= TraceGetAtProcEvt(p, ix);
+  const int e= TraceGetIdProcEvt(p, ix);
+  if(GlOpts.win_mon.enabled) {
+    wmEvt(p, t, e, crit);
+    wmTraffic(p, ix);
+  }
+  if(GlOpts.evt_mon.enabled) {
+    emonEvt(p, t, e, crit);
+  }
+}
+void MonitorFinalize()
+{
+  if(GlOpts.win_mon.enabled) {
+    wmSettle(0, wm.np);
+    wmFinalize(true);
+  }
+  if(GlOpts.evt_mon.enabled) {
+    emonFinalize();
+  }
 }
@@ -12,4 +12,9 @@
 extern void DoMonitoringEventBased();
 extern void DoMonitoringWindowed();
 
+/* online: accumulated during the replay, see monitoring.c */
+extern void MonitorInit(const int);
+extern void MonitorEvt(const int, const long, const double);
+extern void MonitorFinalize();
+
 #endif  /* REPLAY_MONITORING_H__ */
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2025      High Performance Computing Center Stuttgart,
+ *                         University of Stuttgart.  All rights reserved.
+ *
+ * Authors: Kingshuk Haldar <kingshuk.haldar@hlrs.de>
+ *
+ */
+
+#include"network.h"
+#include"common.h"
+#include"utils.h"
+#include"trace_data.h"
+#include"shm.h"
+#include"whatif.h"
+#include<stdlib.h>
+#include<string.h>
+#include<strings.h>
+#include<math.h>
+
+NetType Net= { NULL, NULL, NULL, { 0 }, 0.0, 0.0, NULL, NULL, 0, 0, 1 };
+
+/* ends left out of the replay are fixed to recorded times, which include
+ * the network already
+ */
+inline static bool isBoundaryMsg(const long gid) { return TraceGetMsgSendRank(gid)< 0|| TraceGetMsgRecvRank(gid)< 0; }
+
+/* #nodes the replayed members of a comm are on */
+static int commNumNodes(const int c)
+{
+  const int nn= TraceGetNumNodes();
+  bool *on= (bool *) malloc(sizeof(bool)* nn);
+  memset(on, 0, sizeof(bool)* nn);
+  int n= 0;
+  for(int i= 0; i< TraceGetCommSize(c); ++i) {
+    const int node= TraceGetProcNode(TraceGetCommRank(c, i));
+    if(!on[node]) {
+      on[node]= true;
+      ++n;
+    }
+  }
+  FREE_IF(on);
+  return n;
+}
+
+/* two-level: ideal within a node, latency and bandwidth across nodes */
+static double twoLevelMsg(const long gid)
+{
+  if(isBoundaryMsg(gid)|| TraceGetProcNode(TraceGetMsgSendRank(gid))==
+     TraceGetProcNode(TraceGetMsgRecvRank(gid))) {
+    return 0.0;
+  }
+  const double bw= GlOpts.sim_opts.net.bandwidth;  /* B/ns, aka GB/s */
+  return GlOpts.sim_opts.net.latency+ (bw> 0.0? TraceGetMsgSize(gid)/ bw: 0.0);
+}
+/* only the stage across the nodes costs */
+static int twoLevelColl(const int c, double step[2])
+{
+  const double bw= GlOpts.sim_opts.net.bandwidth;
+  step[0]= GlOpts.sim_opts.net.latency;
+  step[1]= bw> 0.0? 1.0/ bw: 0.0;
+  return commNumNodes(c);
+}
+static const NetModel TwoLevel= { "two-level", twoLevelMsg, twoLevelColl, NULL };
+
+/* LogGP: latency L, overhead o, gap g, gap per byte G, between any ranks */
+inline static double loggp(const int i) { return GlOpts.sim_opts.loggp[i]; }
+static double logGPMsg(const long gid)
+{
+  if(isBoundaryMsg(gid)) {
+    return 0.0;
+  }
+  return loggp(0)+ loggp(3)* MAX(TraceGetMsgSize(gid)- 1.0, 0.0);
+}
+/* over all members, also those left out of the replay */
+static int logGPColl(const int c, double step[2])
+{
+  step[0]= loggp(0)+ 2.0* loggp(1);
+  step[1]= loggp(3);
+  return TraceGetCommSize(c)+ TraceGetCommNumOutside(c);
+}
+static void logGPSetup(NetType *const net)
+{
+  net->overhead= loggp(1);
+  net->gap= loggp(2);
+}
+static const NetModel LogGP= { "LogGP", logGPMsg, logGPColl, logGPSetup };
+
+/* #steps and fraction of the bytes moved in total by an algorithm over n */
+static void collAlgCost(const int alg, const int n, const double step[2],
+                        double cost[2])
+{
+  cost[0]= 0.0;
+  cost[1]= 0.0;
+  if(n< 2) {
+    return;
+  }
+  const double logn= ceil(log2((double) n));
+  const double part= (double)(n- 1)/ n;
+  switch(alg) {
+  case COLL_ALG_TREE:       /* whole message at every level */
+    cost[0]= logn* step[0];
+    cost[1]= logn* step[1];
+    break;
+  case COLL_ALG_RECDBL:     /* halving blocks at every level */
+    cost[0]= logn* step[0];
+    cost[1]= part* step[1];
+    break;
+  case COLL_ALG_RING:       /* a block per step */
+  case COLL_ALG_PAIRWISE:   /* a block per partner */
+  default:
+    cost[0]= (n- 1)* step[0];
+    cost[1]= part* step[1];
+    break;
+  }
+}
+
+/* e.g. "Allreduce:ring,Bcast:tree" over the defaults */
+static void chooseCollAlgs()
+{
+  for(int e= 0; e< NET_MAX_COLL_EVT; ++e) {
+    Net.alg[e]= ParaverCollEvtDefaultAlg(e);
+  }
+  if(NULL== GlOpts.sim_opts.coll_algs) {
+    return;
+  }
+  char *str= strdup(GlOpts.sim_opts.coll_algs);
+  char *save= NULL;
+  for(char *tok= strtok_r(str, ",", &save); NULL!= tok;
+      tok= strtok_r(NULL, ",", &save)) {
+    char *const name= strchr(tok, ':');
+    int evt= -1, alg= -1;
+    if(NULL!= name) {
+      *name= '\0';
+      for(int e= 0; e< NET_MAX_COLL_EVT&& evt< 0; ++e) {
+        if(ParaverEvtIsColl(e)&& 0== strcasecmp(tok, GetParaverMPIEvtName(e))) {
+          evt= e;
+        }
+      }
+      for(int a= 0; a< COLL_NUM_ALGS&& alg< 0; ++a) {
+        if(0== strcasecmp(name+ 1, ParaverCollAlgNames[a])) {
+          alg= a;
+        }
+      }
+    }
+    if(evt< 0|| alg< 0) {
+      if(NULL!= name) {
+        *name= ':';
+      }
+      Error("Invalid collective algorithm \"%s\", ignored\n", tok);
+      continue;
+    }
+    Net.alg[evt]= alg;
+  }
+  FREE_IF(str);
+}
+
+static const NetModel *chooseModel()
+{
+  const bool twolevel= GlOpts.sim_opts.net.latency> 0.0||
+                       GlOpts.sim_opts.net.bandwidth> 0.0;
+  const bool logGP= loggp(0)> 0.0|| loggp(1)> 0.0|| loggp(2)> 0.0||
+                    loggp(3)> 0.0;
+  ErrorIf(twolevel&& logGP, "Two network models chosen, LogGP takes over\n");
+  if(logGP) {
+    return &LogGP;
+  }
+  if(twolevel) {
+    return &TwoLevel;
+  }
+  return NULL;
+}
+
+void NetInit(const int np)
+{
+  Net.model= chooseModel();
+  chooseCollAlgs();             /* validated even if nothing costs them */
+  if(NetIsIdeal()) {
+    return;
+  }
+  if(NULL!= Net.model->setup) {
+    Net.model->setup(&Net);
+  }
+  Net.np= np;
+  Net.nlanes= WhatIfGetNumLanes();
+  const long nmsgs= TraceGetNumMsgs();
+  Net.nmsgs= nmsgs;
+  Net.injected= (double *) ShmAlloc(sizeof(double)* np* Net.nlanes);  /* zero-filled */
+  Net.posts= ShmAlloc(sizeof(*Net.posts)* nmsgs* Net.nlanes);
+  /* ends left out of the replay are posted at their recorded times */
+  for(long g= 0; g< nmsgs; ++g) {
+    for(int l= 0; l< Net.nlanes; ++l) {
+      if(TraceGetMsgSendRank(g)< 0) {
+        netPosts(l, g)[0]= TraceGetMsgSendAt(g, 2);
+      }
+      if(TraceGetMsgRecvRank(g)< 0) {
+        netPosts(l, g)[1]= TraceGetMsgRecvAt(g, 2);
+      }
+    }
+  }
+
+  Net.msg= (double *) malloc(sizeof(double)* nmsgs);
+  for(long g= 0; g< nmsgs; ++g) {
+    Net.msg[g]= Net.model->msg(g);
+  }
+
+  const long nc= TraceGetNumComms();
+  Net.coll= malloc(sizeof(*Net.coll)* nc);
+  memset(Net.coll, 0, sizeof(*Net.coll)* nc);
+  for(long c= 0; c< nc; ++c) {
+    if(TraceIsCommSelf(c)) {
+      continue;
+    }
+    double step[2];
+    const int n= Net.model->coll(c, step);
+    for(int a= 0; a< COLL_NUM_ALGS; ++a) {
+      collAlgCost(a, n, step, Net.coll[c][a]);
+    }
+  }
+  Log1("Network model: %s\n", NetGetModelName());
+}
+void NetFinalize()
+{
+  if(NetIsIdeal()) {
+    return;
+  }
+  ShmFree(Net.posts, sizeof(*Net.posts)* Net.nmsgs* Net.nlanes);
+  Net.posts= NULL;
+  ShmFree(Net.injected, sizeof(double)* Net.np* Net.nlanes);
+  Net.injected= NULL;
+  FREE_IF(Net.coll);
+  FREE_IF(Net.msg);
+  Net.model= NULL;
+}
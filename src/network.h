@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2025      High Performance Computing Center Stuttgart,
+ *                         University of Stuttgart.  All rights reserved.
+ *
+ * Authors: Kingshuk Haldar <kingshuk.haldar@hlrs.de>
+ *
+ */
+
+#ifndef REPLAY_NETWORK_H__
+#define REPLAY_NETWORK_H__
+
+#include"paraver.h"
+#include"shm.h"
+#include<stddef.h>
+#include<stdbool.h>
+
+/* A network model adds time for moving the data of messages and collectives,
+ * on top of the ideal network of the plain replay. The model is evaluated
+ * once per message and per comm before the replay, so that looking up a
+ * delay during the replay costs the same for every model.
+ * For collectives, a model gives the #parties and the cost of a step on a
+ * comm, from which the cost of every algorithm is tabulated per comm.
+ */
+#define NET_MAX_COLL_EVT 256
+struct NetType_struct__;
+typedef struct {
+  const char *name;
+  double (*msg)(const long);    /* transfer time of a message */
+  int (*coll)(const int, double [2]); /* #parties, step [fixed, per-byte] */
+  void (*setup)(struct NetType_struct__ *const); /* optional, e.g. overhead */
+} NetModel;
+
+typedef struct NetType_struct__ {
+  const NetModel *model;        /* NULL: ideal network */
+  double *msg;                  /* len= #msgs */
+  double (*coll)[COLL_NUM_ALGS][2]; /* len= #comms; [fixed, per-byte] */
+  int alg[NET_MAX_COLL_EVT];    /* algorithm per collective-event-id */
+  double overhead;              /* CPU time per message on either end */
+  double gap;                   /* min time between injections of a rank */
+  double *injected;             /* len= #lanes* #procs; last of a rank, its own */
+  double (*posts)[2];           /* len= #lanes* #msgs; send slot, recv post; shared */
+  long nmsgs;
+  int np;
+  int nlanes;                   /* what-if lanes, see whatif.h */
+} NetType;
+
+extern NetType Net;
+
+extern void NetInit(const int);
+extern void NetFinalize();
+
+inline static bool NetIsIdeal() { return NULL== Net.model; }
+inline static const char *NetGetModelName() { return NetIsIdeal()? "ideal": Net.model->name; }
+inline static double NetGetMsgDelay(const long gid) { return Net.msg[gid]; }
+/* time of a collective moving given bytes per member */
+inline static double NetGetCollCost(const int c, const int evt,
+                                    const double bytes)
+{
+  if(NetIsIdeal()) {
+    return 0.0;
+  }
+  const int alg= Net.alg[evt];
+  const double *const cost= Net.coll[c][alg];
+  return ParaverCollEvtNumPhases(evt, alg)* (cost[0]+ cost[1]* bytes);
+}
+inline static double NetGetOverhead() { return Net.overhead; }
+/* A send posted at t0 by rank p takes the next injection slot of the rank in
+ * a lane, given the gap, in the order the sends are posted. Both ends read
+ * the slot of the message, so the delivery includes the wait for it. The
+ * post of the recv is kept as well: the trace has its end once settled.
+ */
+inline static double *netPosts(const int l, const long gid) { return Net.posts[l* Net.nmsgs+ gid]; }
+inline static void NetTakeSendSlot(const int l, const int p, const long gid,
+                                   const double t0)
+{
+  double t= t0;
+  if(Net.gap> 0.0) {
+    double *const injected= Net.injected+ l* Net.np+ p;
+    t= t0> *injected+ Net.gap? t0: *injected+ Net.gap;
+    *injected= t;
+  }
+  ShmStoreDouble(netPosts(l, gid), t);
+}
+inline static double NetGetSendSlot(const int l, const long gid) { return ShmLoadDouble(netPosts(l, gid)); }
+inline static void NetSetRecvPost(const int l, const long gid,
+                                  const double t) { ShmStoreDouble(netPosts(l, gid)+ 1, t); }
+inline static double NetGetRecvPost(const int l, const long gid) { return ShmLoadDouble(netPosts(l, gid)+ 1); }
+
+#endif  /* REPLAY_NETWORK_H__ */
@@ -39,7 +39,9 @@ static struct {
   int *evtId;
   double *tickAt;
   bool *tracingOn;
-} last= { NULL, NULL, NULL, NULL };
+  int *depth;        /* nesting of the events delimiting the what-if region */
+  int *regionDepth;  /* nesting the region is open at */
+} last= { NULL, NULL, NULL, NULL, NULL, NULL };
 
 inline static void initLasts(const int np)
 {
@@ -48,6 +50,8 @@ inline static void initLasts(const int np)
     last.evtId[ip]= -99;
     last.tickAt[ip]= -1.0;
     last.tracingOn[ip]= true; /* appears in trace only when tracing is disabled */
+    last.depth[ip]= 0;
+    last.regionDepth[ip]= 0;
   }
 }
 inline static void allocLasts(const int np)
@@ -56,10 +60,14 @@ inline static void allocLasts(const int np)
   last.evtId= (int *) malloc(sizeof(int)* np);
   last.tickAt= (double *) malloc(sizeof(double)* np);
   last.tracingOn= (bool *) malloc(sizeof(bool)* np);
+  last.depth= (int *) malloc(sizeof(int)* np);
+  last.regionDepth= (int *) malloc(sizeof(int)* np);
   initLasts(np);
 }
 inline static void freeLasts()
 {
+  FREE_IF(last.regionDepth);
+  FREE_IF(last.depth);
   FREE_IF(last.tracingOn);
   FREE_IF(last.tickAt);
   FREE_IF(last.evtId);
@@ -257,7 +265,10 @@ static void countTraceability(const int p, const double at, const int start)
 static void countEvt(char *const line)
 {
   char *ptr= ParaverRecordNextNumNth(line, 3);
-  const int p= atoi(ptr)- 1;
+  const int p= TraceGetReplayRank(atoi(ptr)- 1);
+  if(p< 0) {
+    return;  /* left out of the replay */
+  }
   ptr= ParaverRecordNextNumNth(ptr, 2);
   last.tickAt[p]= atof(ptr);
 
@@ -305,10 +316,21 @@ static void countEvt(char *const line)
 static void countMsg(char *const line)
 {
   char *ptr= ParaverRecordNextNumNth(line, 3);
-  TraceIncrNumProcSends(atoi(ptr)- 1);
+  const int s= TraceGetReplayRank(atoi(ptr)- 1);
 
   ptr= ParaverRecordNextNumNth(ptr, 6);
-  TraceIncrNumProcRecvs(atoi(ptr)- 1);
+  const int r= TraceGetReplayRank(atoi(ptr)- 1);
+
+  if(s>= 0) {
+    TraceIncrNumProcSends(s);
+  } else if(r>= 0) {
+    TraceIncrNumMsgsOut(0);
+  }
+  if(r>= 0) {
+    TraceIncrNumProcRecvs(r);
+  } else if(s>= 0) {
+    TraceIncrNumMsgsOut(1);
+  }
 }
 static void evtsAndCommsCounter(char *const line)
 {
@@ -388,6 +410,33 @@ static void readMPICollEvtComm(const int p, const int comm)
     TraceSetCurrProcCollComm(p, comm);
   }
 }
+/* send/recv sizes of mpi collective */
+static void readMPICollEvtBytes(const int p, const double bytes)
+{
+  if(ParaverEvtIsColl(last.evtId[p])&&
+     likely(ParaverCollEvtIsDimemasCompliant(last.evtId[p]))) {
+    TraceMaxCurrProcCollBytes(p, bytes);
+  }
+}
+/* what-if region: opened by the value given (by default any but 0) and
+ * closed by the 0 at the same nesting
+ */
+static void readRegionEvt(const int p, const double at, const long long value)
+{
+  const long long v= GlOpts.sim_opts.whatif.region[1];
+  if(0!= value) {
+    ++(last.depth[p]);
+    if(!TraceProcIsInRegion(p)&& (0== v|| v== value)) {
+      last.regionDepth[p]= last.depth[p];
+      TraceStartProcRegion(p, at);
+    }
+  } else if(last.depth[p]> 0) {
+    if(last.depth[p]== last.regionDepth[p]) {
+      TraceEndProcRegion(p, at);
+    }
+    --(last.depth[p]);
+  }
+}
 static void readTraceInitEvt(const int p, const double at, const int evt)
 {
   switch(evt) {
@@ -453,7 +502,10 @@ static void readTraceability(const int p, const double at, const int evt)
 static void readEvt(char *const line)
 {
   char *ptr= ParaverRecordNextNumNth(line, 3);
-  const int p= atoi(ptr)- 1;
+  const int p= TraceGetReplayRank(atoi(ptr)- 1);
+  if(p< 0) {
+    return;  /* left out of the replay */
+  }
   ptr= ParaverRecordNextNumNth(ptr, 2);
   last.tickAt[p]= atof(ptr);
   ptr= strchr(ptr, ':');
@@ -471,6 +523,10 @@ static void readEvt(char *const line)
     case 50000005:  /* mpi i/o */
       readMPIEvt(p, last.tickAt[p], atoi(ptr));
       break;
+    case 50100001:  /* send size of mpi collective */
+    case 50100002:  /* recv size of mpi collective */
+      readMPICollEvtBytes(p, atof(ptr));
+      break;
     case 50100004:  /* communicator of mpi collective */
       readMPICollEvtComm(p, atoi(ptr)- 1);
       break;
@@ -486,6 +542,10 @@ static void readEvt(char *const line)
       readTraceability(p, last.tickAt[p], atoi(ptr));
       break;
     default:
+      if(GlOpts.sim_opts.whatif.region[0]> 0&&
+         type== GlOpts.sim_opts.whatif.region[0]) {
+        readRegionEvt(p, last.tickAt[p], atoll(ptr));
+      }
       break;
     }
     ptr= strchr(ptr, ':');
@@ -499,7 +559,12 @@ static void readMsg(char *const line)
   /* 3:scpu:stask:srank:sthread:lsend:psend:rcpu:rtask:rrank:rthread:lrecv:precv:size:tag */
   /*                     0   1   2  3   4   5   6   7   8  9   0   1   2   3  4 */
   char *ptr= ParaverRecordNextNumNth(line, 3);
-  TraceSetCurrMsgSendRank(atoi(ptr)- 1);
+  const int s= TraceGetReplayRank(atoi(ptr)- 1);
+  const int r= TraceGetReplayRank(atoi(ParaverRecordNextNumNth(ptr, 6))- 1);
+  if(s< 0&& r< 0) {
+    return;  /* both ends left out of the replay */
+  }
+  TraceSetCurrMsgSendRank(s);
 
   ptr= ParaverRecordNextNumNth(ptr, 2);
   TraceSetCurrMsgSendAt(0, atof(ptr));
@@ -508,7 +573,7 @@ static void readMsg(char *const line)
   TraceSetCurrMsgSendAt(1, atof(ptr));
 
   ptr= ParaverRecordNextNumNth(ptr, 3);
-  TraceSetCurrMsgRecvRank(atoi(ptr)- 1);
+  TraceSetCurrMsgRecvRank(r);
 
   ptr= ParaverRecordNextNumNth(ptr, 2);
   TraceSetCurrMsgRecvAt(0, atof(ptr));
@@ -522,8 +587,15 @@ static void readMsg(char *const line)
   ptr= ParaverRecordNextNum(ptr);
   TraceSetCurrMsgTag(atoi(ptr));
 
-  TraceSetProcSendRecvGids(TraceGetCurrMsgSendRank(),
-                           TraceGetCurrMsgRecvRank());
+  TraceSetProcSendRecvGids(s, r);
+
+  /* the end left out is fixed to its recorded post, as if posted already */
+  if(s< 0) {
+    TraceSetCurrMsgSendAt(2, *TraceGetPtrCurrMsgSendAt(0));
+  }
+  if(r< 0) {
+    TraceSetCurrMsgRecvAt(2, *TraceGetPtrCurrMsgRecvAt(0));
+  }
 
   TraceIncrIterMsgs();
 }
@@ -587,7 +659,13 @@ static void finishRead(const int np)
     Debug1("collective-count check successful\n");
   }
 
-  if(GlOpts.evt_mon.enabled) {
+  for(int ip= 0; ip< np; ++ip) {
+    TraceEndProcRegion(ip, TraceGetProcEndTime(ip));  /* if still open */
+  }
+
+  if(GlOpts.evt_mon.enabled&& NULL!= GlOpts.evt_mon.ranks) {
+    printf("Event-driven monitoring ranks: %s\n", GlOpts.evt_mon.ranks);
+  } else if(GlOpts.evt_mon.enabled) {
     printf("Event-driven monitoring rank:");
     if(GlOpts.evt_mon.rank< 0|| GlOpts.evt_mon.rank>= TraceGetNumProcs()) {
       int pMaxUseful= 0;
@@ -761,13 +839,36 @@ inline static double processParaverFile(ParaverFile *const file,
   ParaverFileReloadRecords(file);
   return ParaverFileProcess(file, !GlOpts.show_opts.timings);
 }
+/* events excused by the chosen ignore policy: ignored (trace-init, flush,
+ * disabled) regions are then accounted as the preceding state
+ */
+static bool ignoredEvt(const int p, const long ix)
+{
+  const int curr= TraceGetIdProcEvt(p, ix);
+  const int prev= 0== ix? -99: TraceGetIdProcEvt(p, ix- 1);
+
+  if(GlOpts.sim_opts.ignore.trace_evts&& (-4== prev|| -4== curr)) {
+    return true;
+  }
+
+  if(GlOpts.sim_opts.ignore.flush_evts&& (-3== prev|| -3== curr)) {
+    return true;
+  }
+
+  if(GlOpts.sim_opts.ignore.disabled_tracing&& ((-2== prev&& 0== curr)||
+                                                -2== curr)) {
+    return true;
+  }
+
+  return false;
+}
 int ReadParaverFile(const char *const fn)
 {
   ParaverFile *file= ParaverFileOpen(fn);
 
   SetWorkingTrace(CreateTrace(file));
 
-  const int np= ParaverFileGetNumProcs(file);
+  const int np= TraceGetNumProcs();
   allocLasts(np);
 
   const double tioCount= processParaverFile(file, evtsAndCommsCounter);
@@ -789,6 +890,13 @@ int ReadParaverFile(const char *const fn)
 
   showAggregated(np);
 
+  if(GlOpts.sim_opts.ignore.trace_evts|| GlOpts.sim_opts.ignore.flush_evts||
+     GlOpts.sim_opts.ignore.disabled_tracing) {
+    const long ndropped= TraceDropProcEvts(ignoredEvt);
+    Debug1("Dropped %ld ignored events, %ld remain\n", ndropped,
+           TraceGetNumEvts());
+  }
+
   freeLasts();
 
   ParaverFileClose(file); file= NULL;
@@ -817,3 +925,7 @@ const char *GetParaverMPIEvtName(const int ev)
 
   return "Strange";
 }
+
+const char *const ParaverCollAlgNames[COLL_NUM_ALGS]= {
+  "tree", "ring", "recdbl", "pairwise"
+};
@@ -67,4 +67,44 @@ inline static bool ParaverCollEvtIsDimemasCompliant(const int evtId)
   return ret;
 }
 
+/* algorithms a collective is costed by, once a network model is chosen */
+enum {
+  COLL_ALG_TREE= 0,   /* binomial tree */
+  COLL_ALG_RING,      /* ring, pipelining a block per step */
+  COLL_ALG_RECDBL,    /* recursive doubling/halving */
+  COLL_ALG_PAIRWISE,  /* pairwise exchange, a distinct partner per step */
+  COLL_NUM_ALGS
+};
+extern const char *const ParaverCollAlgNames[COLL_NUM_ALGS];
+
+/* what MPI libraries typically use for mid-sized messages */
+inline static int ParaverCollEvtDefaultAlg(const int evtId)
+{
+  int ret= COLL_ALG_TREE;
+  switch(evtId) {
+  case 8:   /* Barrier */
+  case 10:  /* Allreduce */
+  case 30:  /* Scan */
+    ret= COLL_ALG_RECDBL;
+    break;
+  case 11:  /* Alltoall */
+  case 12:  /* Alltoallv */
+    ret= COLL_ALG_PAIRWISE;
+    break;
+  case 17:  /* Allgather */
+  case 18:  /* Allgatherv */
+  case 80:  /* Reduce_scatter */
+    ret= COLL_ALG_RING;
+    break;
+  default:
+    break;
+  }
+  return ret;
+}
+/* #times the algorithm runs, e.g. reduce-scatter+ allgather for allreduce */
+inline static int ParaverCollEvtNumPhases(const int evtId, const int alg)
+{
+  return 10== evtId&& COLL_ALG_TREE!= alg? 2: 1;
+}
+
 #endif  /* REPLAY_PARAVER_H__ */
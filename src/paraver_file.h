@@ -54,6 +54,8 @@ inline static int ParaverFileGetAllCommsSizes(const ParaverFile *const
 inline static int ParaverFileReadComms(const ParaverFile *const paraverFile,
                                        int *const commsSizes,
                                        int **const commsRanks);
+inline static int ParaverFileReadTaskNodes(const ParaverFile *const paraverFile,
+                                           int *const taskNodes);
 
 inline static int ParaverFileReloadRecords(const ParaverFile *const
                                            paraverFile);
@@ -269,6 +271,54 @@ inline static int ParaverFileReadComms(const ParaverFile *const file,
   return 0;
 }
 
+/* node (0-based) of every task of every app, from the header's
+ * "ntasks(nthreads:node,...)" lists
+ */
+inline static int ParaverFileReadTaskNodes(const ParaverFile *const file,
+                                           int *const nodes)
+{
+  int ret= fseeko(file->fp, 0, SEEK_SET);
+  if(-1== ret) {
+    printf("%s: cannot reload header!\n", __func__);
+    return -1;
+  }
+
+  char *str= NULL; size_t n= 0;
+  if(-1== getline(&str, &n, file->fp)) {
+    printf("%s: Call to getline() failed.\n", __func__);
+    ret= -1;
+    goto bye;
+  }
+
+  /*                  #Paraver (date):runtime:nodes(cpus):napps:      */
+  char *ptr= strchr(str, ')')+ 2;
+  ptr= strchr(ptr, ':')+ 1;
+  ptr= strchr(ptr, ':')+ 1;
+  ptr= strchr(ptr, ':')+ 1;
+  for(int it= 0; it< file->numProcs&& NULL!= ptr; ) {
+    const int ntasks= atoi(ptr);
+    ptr= strchr(ptr, '(');
+    for(int i= 0; i< ntasks&& NULL!= ptr; ++i, ++it) {
+      ptr= strchr(ptr+ 1, ':');
+      if(NULL!= ptr) {
+        nodes[it]= atoi(ptr+ 1)- 1;
+        ptr= strpbrk(ptr, ",)");
+      }
+    }
+    ptr= NULL!= ptr? strchr(ptr, ':'): NULL;  /* next app */
+    if(NULL!= ptr) {
+      ++ptr;
+    }
+  }
+
+bye:
+  if(NULL!= str) {
+    free(str);
+    str= NULL;
+  }
+  return ret;
+}
+
 inline static int ParaverFileReloadRecords(const ParaverFile *const file)
 {
   int ret= fseeko(file->fp, file->recordsAt, SEEK_SET);
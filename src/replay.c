@@ -16,12 +16,19 @@
 #include"clocks.h"
 #include"collectives.h"
 #include"monitoring.h"
+#include"waitfor.h"
+#include"shm.h"
+#include"skew.h"
+#include"network.h"
+#include"whatif.h"
 #include<stdio.h>
 #include<stdlib.h>
 #include<stdbool.h>
 #include<string.h>
 #include<math.h>
 #include<float.h>
+#include<limits.h>
+#include<sched.h>
 
 inline static void initialiseClocks(const int np)
 {
@@ -33,6 +40,7 @@ static void initialiseCollectives(const int np)
   CollsAlloc();
   CollsResetAll();
 }
+inline static void initialiseWaitFor(const int np) { WaitForInit(np); }
 inline static int checkEvtsCompletion(const int p, bool *const completed)
 {
   completed[p]= !TraceRemainsProcEvts(p);
@@ -48,40 +56,38 @@ inline static const char *pevtname(const int p) { return evt2name(pevt(p)); }
 inline static double tcevt(const int p) { return TraceGetAtCurrProcEvt(p); }
 inline static double tpevt(const int p) { return TraceGetAtPrevProcEvt(p); }
 
-inline static bool excuse(const int prev, const int curr)
+/* the critical time of an event is final: kept for the monitors after the
+ * replay, or handed to them right away
+ */
+inline static void fixCrit(const int p, const long ix, const double crit)
 {
-  if(GlOpts.sim_opts.ignore.trace_evts&& (-4== prev|| -4== curr)) {
-    return true;
-  }
-
-  if(GlOpts.sim_opts.ignore.flush_evts&& (-3== prev|| -3== curr)) {
-    return true;
+  if(TraceHasEvtsCrit()) {
+    TraceSetEvtCrit(TraceGetProcEvtGid(p, ix), crit);
   }
-
-  if(GlOpts.sim_opts.ignore.disabled_tracing&& ((-2== prev&& 0== curr)||
-                                                -2== curr)) {
-    return true;
+  if(GlOpts.online_mon) {
+    MonitorEvt(p, ix, crit);
   }
-
-  ErrorIf(-99==curr, "Invalid state encountered\n");
-
-  return false;
 }
+inline static void fixCurrCrit(const int p) { fixCrit(p, TraceGetIterProcEvts(p), ClockGetCritical(p)); }
 
 static void enterMPI_Init(const int p)
 {
   ClockPauseMPI(p, tcevt(p), cevt(p));
   Debug1("%d: enter %s at %.0lf -> %.0lf\n", p, cevtname(p), tcevt(p),
          ClockGetCritical(p));
-  TraceSetCritCurrProcEvt(p, ClockGetCritical(p));
+  fixCurrCrit(p);
   TraceIncrIterProcEvts(p);
 }
-static void leaveMPI_InitAt(const int p, const double at)
+/* at: per lane */
+static void leaveMPI_InitAt(const int p, const double *const at)
 {
-  ClockSetCritical(p, at);
+  ClockSetCritical(p, at[0]);
+  for(int l= 1; l< ClockGetNumLanes(); ++l) {
+    ClockSetLaneCritical(l, p, at[l]);
+  }
   ClockPlay(p, TraceGetAtCurrProcEvt(p), 0);
-  Debug1("%d: exit %s at %.0lf -> %.0lf\n", p, pevtname(p), tcevt(p), at);
-  TraceSetCritCurrProcEvt(p, ClockGetCritical(p));
+  Debug1("%d: exit %s at %.0lf -> %.0lf\n", p, pevtname(p), tcevt(p), at[0]);
+  fixCurrCrit(p);
   TraceIncrIterProcEvts(p);
 }
 
@@ -89,20 +95,17 @@ static void localiseMPIUntilEvtExcl(const int p, const int untilEvt)
 {
   const long untilIx= TraceSearchIterProcEvtId(p, untilEvt);
   while(TraceGetIterProcEvts(p)< untilIx) {
-    const int eprev= pevt(p);
     const int e= cevt(p);
     const double t= tcevt(p);
 
-    if(!excuse(eprev, e)) {
-      if(e> 0) {
-        ClockPauseMPI(p, t, e);
-      } else if(e< 0) {
-        ClockPauseTrace(p, t, e);
-      } else {
-        ClockPlay(p, t, e);
-      }
-      TraceSetCritCurrProcEvt(p, ClockGetCritical(p));
+    if(e> 0) {
+      ClockPauseMPI(p, t, e);
+    } else if(e< 0) {
+      ClockPauseTrace(p, t, e);
+    } else {
+      ClockPlay(p, t, e);
     }
+    fixCurrCrit(p);
     TraceIncrIterProcEvts(p);
   }
 }
@@ -111,24 +114,30 @@ inline static void localiseMPIUntilEvtIncl(const int p, const int untilEvt)
   localiseMPIUntilEvtExcl(p, untilEvt);
   const long untilIx= TraceGetIterProcEvts(p)+ 2;
   while(TraceGetIterProcEvts(p)< untilIx) {
+    fixCrit(p, TraceGetIterProcEvts(p), 0.0);  /* left out */
     TraceIncrIterProcEvts(p);
   }
 }
 static void playMPI_Init(const int np)
 {
   if(TraceAllHaveMPIInitEvt()) {
-    double lastEntry= 0.0;
+    const int nl= ClockGetNumLanes();
+    double *lastEntry= (double *) malloc(sizeof(double)* nl);
+    memset(lastEntry, 0, sizeof(double)* nl);
     for(int ip= 0; ip< np; ++ip) {
       localiseMPIUntilEvtExcl(ip, 31);
       enterMPI_Init(ip);
 #if 0
       ClockDebug(ip);
 #endif
-      lastEntry= MAX(ClockGetCritical(ip), lastEntry);
+      for(int l= 0; l< nl; ++l) {
+        lastEntry[l]= MAX(ClockGetLaneCritical(l, ip), lastEntry[l]);
+      }
     }
     for(int ip= 0; ip< np; ++ip) {
       leaveMPI_InitAt(ip, lastEntry);
     }
+    FREE_IF(lastEntry);
   } else if(TraceAnyHasMPIInitEvt()) {
     for(int ip= 0; ip< np; ++ip) {
       if(TraceProcHasMPIInitEvt(ip)) {
@@ -139,6 +148,7 @@ static void playMPI_Init(const int np)
 }
 
 static int nstucks= 0;
+static long nchanges= 0;        /* progress visible to others, other than events */
 inline static bool posted(const double *const t) { return t[2]> 0.1; }
 inline static bool settled(const double *const t) { return t[2]< -0.1; }
 inline static bool seen(const double *const t) { return posted(t)|| settled(t); }
@@ -147,6 +157,46 @@ inline static bool instant(const double *const t) { return SameTime(t[1], t[0]);
 inline static int sremote(const int p, const long ix) { return TraceGetProcSendRemote(p, ix); }
 inline static int rremote(const int p, const long ix) { return TraceGetProcRecvRemote(p, ix); }
 inline static bool rillogical(const int p, const long ix) { return TraceGetSendAtProcRecv(p, ix, 0)> TraceGetProcRecvAt(p, ix, 1); }
+/* the stamp of a message end, read by the rank at the other end; stored last,
+ * after the posts of the lanes and the network
+ */
+inline static double getStamp(double *const t) { return ShmLoadDouble(t+ 2); }
+inline static void setStamp(double *const t, const double v) { ShmStoreDouble(t+ 2, v); }
+/* message posts per what-if lane, the end of a recv once it is settled: lane 0
+ * keeps them in the trace
+ */
+inline static double lsendpost(const int l, const long gid) { return 0== l? fabs(getStamp(TraceGetPtrMsgSendAt(gid, 0))): WhatIfGetSendPost(l, gid); }
+inline static double lrecvpost(const int l, const long gid) { return 0== l? fabs(getStamp(TraceGetPtrMsgRecvAt(gid, 0))): WhatIfGetRecvPost(l, gid); }
+/* lane and network posts (and recv ends of lanes) are seen by the other end
+ * once it reads the stamp of lane 0
+ */
+inline static bool sharedPosts() { return WhatIfHasLanes()|| !NetIsIdeal(); }
+static void postNet(const long gid, const bool send, const int p)
+{
+  if(NetIsIdeal()) {
+    return;
+  }
+  for(int l= 0; l< ClockGetNumLanes(); ++l) {
+    if(send) {
+      NetTakeSendSlot(l, p, gid, ClockGetLaneCritical(l, p));
+    } else {
+      NetSetRecvPost(l, gid, ClockGetLaneCritical(l, p));
+    }
+  }
+}
+static void postLanes(const long gid, const bool send, const int p)
+{
+  if(!sharedPosts()) {
+    return;
+  }
+  for(int l= 1; l< ClockGetNumLanes(); ++l) {
+    if(send) {
+      WhatIfSetSendPost(l, gid, ClockGetLaneCritical(l, p));
+    } else {
+      WhatIfSetRecvPost(l, gid, ClockGetLaneCritical(l, p));
+    }
+  }
+}
 static void postOneSend(const int p, const long ix)
 {
   double *const tsends= TraceGetProcSendAts(p, ix);
@@ -162,7 +212,13 @@ static void postOneSend(const int p, const long ix)
           tcevt(p), tsends[0]);
   Debug1("%d: send-%d: start %.0lf -> %.0lf\n", p, sremote(p, ix), tcevt(p),
          ClockGetCritical(p));
-  TraceSetProcSendAt(p, ix, 2, ClockGetCritical(p));
+  const long gid= TraceGetProcSendGid(p, ix);
+  if(!seen(tsends)) {
+    ++nchanges;
+    postNet(gid, true, p);
+  }
+  postLanes(gid, true, p);
+  setStamp(tsends, ClockGetCritical(p));
 }
 static void postSends(const int p)
 {
@@ -187,7 +243,13 @@ static void postOneRecv(const int p, const long ix)
           tcevt(p), trecvs[0]);
   Debug1("%d: recv-%d: start %.0lf -> %.0lf\n", p, rremote(p, ix), tcevt(p),
          ClockGetCritical(p));
-  TraceSetProcRecvAt(p, ix, 2, ClockGetCritical(p));
+  const long gid= TraceGetProcRecvGid(p, ix);
+  if(!seen(trecvs)) {
+    ++nchanges;
+    postNet(gid, false, p);
+  }
+  postLanes(gid, false, p);
+  setStamp(trecvs, ClockGetCritical(p));
 }
 static void postRecvs(const int p)
 {
@@ -229,6 +291,7 @@ static int postColls(const int p)
   goto bye;
 
 noresolve:
+  WaitForBlock(p, WAIT_COLL_BUSY, c);
   ret= 1;
 bye:
   return ret;
@@ -239,8 +302,14 @@ static int settleColls(const int p)
     return 0;
   }
   int ret= 0;
-  if(!TraceIsCommSelf(TraceGetCommCurrProcColl(p))) {
-    ret= LeaveColl(TraceGetCommCurrProcColl(p), p, tcevt(p), pevt(p));
+  const int c= TraceGetCommCurrProcColl(p);
+  if(!TraceIsCommSelf(c)) {
+    ret= LeaveColl(c, p, tcevt(p), pevt(p));
+    if(0!= ret) {
+      WaitForBlock(p, WAIT_COLL, c);
+    } else {
+      ++nchanges;
+    }
   }
 
   if(0== ret) {
@@ -249,10 +318,75 @@ static int settleColls(const int p)
   return ret;
 }
 
-inline static bool NonblockingSendExit(const int p) { return 3== pevt(p)|| 36== pevt(p)|| 37== pevt(p)|| 38== pevt(p); }
-inline static bool classicNonblockingSendExit(const int p,
-                                              const double *const t) { return NonblockingSendExit(p)&& SameTime(t[0], tpevt(p))&& SameTime(t[1], tcevt(p)); }
+inline static bool NonblockingSendExit(const int e) { return 3== e|| 36== e|| 37== e|| 38== e; }
+inline static bool classicNonblockingSendExit(const int p, const long ix,
+                                              const double *const t)
+{
+  const int eprev= 0== ix? -99: TraceGetIdProcEvt(p, ix- 1);
+  const double tprev= 0== ix? TraceGetProcStartTime(p): TraceGetAtProcEvt(p,
+                                                                           ix- 1);
+  return NonblockingSendExit(eprev)&& SameTime(t[0], tprev)&&
+         SameTime(t[1], TraceGetAtProcEvt(p, ix));
+}
+
+/* messages and bytes per protocol */
+static struct {
+  long nmsgs[MSG_NUM_PROTOS];
+  double nbytes[MSG_NUM_PROTOS];
+} Protos;
+inline static const char *protoname(const int proto)
+{
+  static const char *const names[MSG_NUM_PROTOS]= {
+    "instant", "non-blocking", "eager", "rendezvous"
+  };
+  return names[proto];
+}
+
+/* protocol of a send ending at event ix of p: fixed by the trace */
+static int sendProtocol(const int p, const long ix, const long gid)
+{
+  const double *const t= TraceGetPtrMsgSendAt(gid, 0);
+  if(instant(t)) {
+    return MSG_PROTO_INSTANT;
+  }
+  if(classicNonblockingSendExit(p, ix, t)) {
+    return MSG_PROTO_NONBLOCKING;
+  }
+  if(TraceGetMsgSize(gid)< GlOpts.sim_opts.eager_limit) {
+    return MSG_PROTO_EAGER;
+  }
+  return MSG_PROTO_RENDEZVOUS;
+}
+static void classifyMsgs(const int np)
+{
+  memset(&Protos, 0, sizeof(Protos));
+  for(int ip= 0; ip< np; ++ip) {
+    for(long ix= 0; ix< TraceGetNumProcEvts(ip); ++ix) {
+      for(IndexList *ixs= TraceGetProcEvtSends(ip, 1, ix); NULL!= ixs;
+          ixs= ixs->next) {
+        const long gid= TraceGetProcSendGid(ip, ixs->i);
+        const int proto= sendProtocol(ip, ix, gid);
+        TraceSetMsgProto(gid, proto);
+        ++(Protos.nmsgs[proto]);
+        Protos.nbytes[proto]+= TraceGetMsgSize(gid);
+      }
+    }
+  }
+  for(int k= 0; k< MSG_NUM_PROTOS; ++k) {
+    Debug1("%s: %ld messages, %.0lf bytes\n", protoname(k), Protos.nmsgs[k],
+           Protos.nbytes[k]);
+  }
+}
 
+/* data of a send through the network: it leaves the rank in its injection
+ * slot, and a rendezvous lasts until it is through
+ */
+inline static double tsent(const long gid, const double t0,
+                           const bool rendezvous)
+{
+  const double t= t0+ NetGetOverhead();
+  return rendezvous? t+ NetGetMsgDelay(gid): t;
+}
 /* returns 1 if this send is settled, 0 otherwise */
 static int settleOneSend(const int p, const long ix)
 {
@@ -266,33 +400,42 @@ static int settleOneSend(const int p, const long ix)
     goto bye;  /* already settled: just return */
   }
 
-  if(instant(tsends)) {         /* instant in trace: settle */
-    msg= "instant"; goto settle;
-  }
-
-  if(classicNonblockingSendExit(p, tsends)) {     /* Isend-exit: settle */
-    msg= "non-blocking"; goto settle;
-  }
-
-  if(TraceGetProcSendSize(p, ix)< GlOpts.sim_opts.eager_limit) {
-    msg= "eager"; goto settle;
+  switch(TraceGetProcSendProto(p, ix)) {
+  case MSG_PROTO_INSTANT:       /* instant in trace: settle */
+  case MSG_PROTO_NONBLOCKING:   /* Isend-exit: settle */
+  case MSG_PROTO_EAGER:
+    if(!NetIsIdeal()) {
+      const long gid= TraceGetProcSendGid(p, ix);
+      for(int l= 0; l< ClockGetNumLanes(); ++l) {
+        ClockRaiseLaneCritical(l, p, tsent(gid, NetGetSendSlot(l, gid), false));
+      }
+    }
+    msg= protoname(TraceGetProcSendProto(p, ix)); goto settle;
+  default:
+    break;
   }
 
-  const double trecv= fabs(TraceGetRecvAtProcSend(p, ix, 2));
+  const double trecv= fabs(getStamp(TraceGetRecvAtsProcSend(p, ix)));
   if(trecv> 0.1) {           /* remote recv is posted, settle */
-    if(trecv> ClockGetCritical(
-         p)) { /* recv posted after clock-val - serialisation */
-      ClockSetCritical(p, trecv);
+    const long gid= TraceGetProcSendGid(p, ix);
+    for(int l= 0; l< ClockGetNumLanes(); ++l) {
+      /* ideal: till the recv is posted, or done if it is already */
+      const double tdone= NetIsIdeal()? lrecvpost(l, gid):
+                          tsent(gid, MAX(NetGetRecvPost(l, gid),
+                                         NetGetSendSlot(l, gid)), true);
+      /* recv posted after clock-val - serialisation */
+      ClockRaiseLaneCritical(l, p, tdone);
     }
     msg= "rendezvous"; goto settle;
   }
 
   Debug1("%d: send-%d: end %.0lf -> unresolved rendezvous\n", p, sremote(p, ix),
          tcevt(p));
+  WaitForBlock(p, WAIT_SEND, TraceGetProcSendGid(p, ix));
   ret= 0; goto bye;
 
 settle:
-  TraceSetProcSendAt(p, ix, 2, -tsends[2]); /* flip sign */
+  setStamp(tsends, -tsends[2]); /* flip sign */
   Debug1("%d: send-%d: end %.0lf -> %.0lf %s\n", p, sremote(p, ix), tcevt(p),
          ClockGetCritical(p), msg);
 
@@ -313,6 +456,16 @@ static int settleSends(const int p)
   return (total== settled? 0: 1);
 }
 
+/* data of a recv through the network: a rendezvous starts moving it only
+ * once both sides are posted
+ */
+inline static double tdelivered(const int l, const long gid)
+{
+  const double slot= NetGetSendSlot(l, gid);
+  const double t0= MSG_PROTO_RENDEZVOUS== TraceGetMsgProto(gid)?
+                   MAX(slot, NetGetRecvPost(l, gid)): slot;
+  return t0+ NetGetMsgDelay(gid)+ 2.0* NetGetOverhead();  /* o at both ends */
+}
 static int settleOneRecv(const int p, const long ix)
 {
   int ret= 1; const char *msg= "default";
@@ -327,17 +480,19 @@ static int settleOneRecv(const int p, const long ix)
 
   /* if(instant(trecvs)) { msg= "instant";  goto settle; } */
 
-  const double tsend= fabs(TraceGetSendAtProcRecv(p, ix, 2));
+  const double tsend= fabs(getStamp(TraceGetSendAtsProcRecv(p, ix)));
   if(tsend> 0.1) {           /* remote send is posted, settle */
-    if(tsend> ClockGetCritical(
-         p)) { /* send posted after clock-val - serialisation */
-      ClockSetCritical(p, tsend);
+    const long gid= TraceGetProcRecvGid(p, ix);
+    for(int l= 0; l< ClockGetNumLanes(); ++l) {
+      const double tdone= NetIsIdeal()? lsendpost(l, gid): tdelivered(l, gid);
+      /* send posted after clock-val - serialisation */
+      ClockRaiseLaneCritical(l, p, tdone);
     }
     msg= "remote-post"; goto settle;
   }
 
-  /* If all are stuck and unresolved illogical receives are encountered,
-   * settle them with current time.
+  /* If all are stuck and unresolved illogical receives are encountered on
+   * the ranks of a wait-for cycle, settle them with current time.
    * Illogical receives finish before corresponding sends are even posted.
    * They arise due to clock-skew and/or time dilation and are usually fixable.
    * Rarely, incorrect message matching in Paraver files show up this way,
@@ -345,7 +500,7 @@ static int settleOneRecv(const int p, const long ix)
    * This "hack" ends such receives so that the best possible monitor even with
    * a mismatched trace can be obtained.
    */
-  if(nstucks> 0&& rillogical(p, ix)) {
+  if(WaitForIsInvolved(p)&& rillogical(p, ix)) {
     Error("%d: illogical send-recv pair (%.0lf:%.0lf) <- rank-%d (%.0lf:%.0lf)\n",
           p,
           trecvs[0], trecvs[1], rremote(p, ix),
@@ -355,10 +510,12 @@ static int settleOneRecv(const int p, const long ix)
 
   Debug1("%d: recv-%d: end %.0lf -> unresolved remote-not-posted\n", p, rremote(p,
          ix), tcevt(p));
+  WaitForBlock(p, WAIT_RECV, TraceGetProcRecvGid(p, ix));
   ret= 0; goto bye;
 
 settle:
-  TraceSetProcRecvAt(p, ix, 2, -ClockGetCritical(p));
+  postLanes(TraceGetProcRecvGid(p, ix), false, p);  /* ends, as lane 0 */
+  setStamp(trecvs, -ClockGetCritical(p));
   Debug1("%d: recv-%d: end %.0lf -> %.0lf %s\n", p, rremote(p, ix), tcevt(p),
          ClockGetCritical(p), msg);
 
@@ -389,19 +546,62 @@ static int settleMsgs(const int p)
   return 0;
 }
 
+/* events needing only clock accounting: no p2p, no collective */
+static bool clockOnlyEvt(const int p, const long ix)
+{
+  const long gid= TraceGetProcEvtGid(p, ix);
+  if(NULL!= TraceGetEvtSends(0, gid)|| NULL!= TraceGetEvtSends(1, gid)||
+     NULL!= TraceGetEvtRecvs(0, gid)|| NULL!= TraceGetEvtRecvs(1, gid)) {
+    return false;
+  }
+  const int e= TraceGetIdProcEvt(p, ix);
+  const int eprev= 0== ix? -99: TraceGetIdProcEvt(p, ix- 1);
+  if(-99== e|| -1== e|| -2== e) {
+    return false;
+  }
+  if(ParaverCollEvtIsDimemasCompliant(e)|| (0== e&&
+                                            ParaverCollEvtIsDimemasCompliant(eprev))) {
+    return false;  /* entering or leaving collective */
+  }
+  return true;
+}
+
+/* critical times of a span of events, till they are fixed */
+static struct {
+  double *crit;
+  long len;
+} Span= { NULL, 0 };
+
 /* progresses as much as possible without talking */
 #if 1
 static int processRank(const int p)
 {
   int movement= 0;
+  const bool fastForward= TraceHasProcSpans();
   while(TraceRemainsProcEvts(p)) {
+    if(fastForward&& TraceGetCurrProcSpanLen(p)> 0) {
+      const long ix= TraceGetIterProcEvts(p);
+      const long len= TraceGetCurrProcSpanLen(p);
+      if(len> Span.len) {
+        Span.len= len;
+        Span.crit= (double *) realloc(Span.crit, sizeof(double)* len);
+      }
+      const long n= ClockPlaySpan(p, len, TraceGetPtrProcEvtsGids(p)+ ix,
+                                  TraceGetPtrEvtsAt(), TraceGetPtrEvtsId(),
+                                  Span.crit);
+      for(long i= 0; i< n; ++i) {
+        fixCrit(p, ix+ i, Span.crit[i]);
+      }
+      if(n> 0) {
+        TraceSetIterProcEvts(p, ix+ n);
+        movement+= n;
+        continue;
+      }
+    }
+
     const double t= tcevt(p);
     const int e= cevt(p);
 
-    if(excuse(pevt(p), e)) {
-      goto excused;
-    }
-
     if(e> 0) {                       /* enter MPI */
       ClockPauseMPI(p, t, e);
       postMsgs(p);
@@ -427,18 +627,10 @@ static int processRank(const int p)
       }
       ClockPlay(p, t, e);
     }
-    TraceSetCritCurrProcEvt(p, ClockGetCritical(p));
-
-    const char *status= "processed";
-    goto through;
+    fixCurrCrit(p);
 
-excused:
-    /* TraceSetCurrEvtCrit(z); */
-    status= "excused";
-
-through:
-    Debug1("%d: %s -> %s at %.0lf (%.0lf) - %s\n", p, pevtname(p),
-           cevtname(p), ClockGetElapsed(p), ClockGetCritical(p), status);
+    Debug1("%d: %s -> %s at %.0lf (%.0lf) - processed\n", p, pevtname(p),
+           cevtname(p), ClockGetElapsed(p), ClockGetCritical(p));
     TraceIncrIterProcEvts(p);
     ++movement;
   }
@@ -458,10 +650,6 @@ static int processRank(const int p)
   const double t= tcevt(p);
   const int e= cevt(p);
 
-  if(unlikely(excuse(pevt(p), e))) {
-    goto excused;
-  }
-
   if(e> 0) {                       /* enter MPI */
     ClockPauseMPI(p, t, e);
     postMsgs(p);
@@ -488,15 +676,8 @@ static int processRank(const int p)
     ClockPlay(p, t, e);
   }
 
-  const char *status= "processed";
-  goto through;
-
-excused:
-  status= "excused";
-
-through:
-  Debug1("%d: %s -> %s at %.0lf (%.0lf) - %s\n", p, pevtname(p),
-         cevtname(p), ClockGetElapsed(p), ClockGetCritical(p), status);
+  Debug1("%d: %s -> %s at %.0lf (%.0lf) - processed\n", p, pevtname(p),
+         cevtname(p), ClockGetElapsed(p), ClockGetCritical(p));
   TraceIncrIterProcEvts(p);
   ++movement;
 
@@ -514,20 +695,9 @@ static void calcMonRanksTimepoints(long *const n, double *const umax,
 
   TraceResetProcIters();
   while(TraceRemainsProcEvts(p)) {
-    const int e= cevt(p);
-    if(excuse(pevt(p), e)) {
-      goto excused;
-    }
-    if(0== e) {
+    if(0== cevt(p)) {
       ++npoints;
     }
-
-    goto through;
-
-excused:
-    ;
-
-through:
     TraceIncrIterProcEvts(p);
   }
   printf("#points in tl-file: %ld\n", npoints);
@@ -535,36 +705,316 @@ through:
 }
 #endif
 
-static void processTrace()
+/* wait-for graph of the blocked ranks, from their last recorded reasons;
+ * rebuilt only once a sweep over all ranks did not progress, so it costs no
+ * more than that sweep and nothing while the replay progresses
+ */
+static void buildWaitForGraph(const int np, const bool *const completed)
+{
+  WaitForResetGraph();
+  for(int ip= 0; ip< np; ++ip) {
+    if(completed[ip]) {
+      continue;
+    }
+    const long what= WaitForGetWhat(ip);
+    switch(WaitForGetReason(ip)) {
+    case WAIT_RECV:             /* ends left out of the replay are posted */
+      if(TraceGetMsgSendRank(what)>= 0) {
+        WaitForAddEdge(ip, TraceGetMsgSendRank(what));
+      }
+      break;
+    case WAIT_SEND:
+      if(TraceGetMsgRecvRank(what)>= 0) {
+        WaitForAddEdge(ip, TraceGetMsgRecvRank(what));
+      }
+      break;
+    case WAIT_COLL: {
+        const long seq= CollGetSeq(what, ip);
+        for(int i= 0; i< TraceGetCommSize(what); ++i) {
+          const int q= TraceGetCommRank(what, i);
+          if(!CollMemberHasEntered(what, q, seq)) {
+            WaitForAddEdge(ip, q);
+          }
+        }
+      }
+      break;
+    case WAIT_COLL_BUSY: {
+        const long seq= CollGetBusySeq(what, ip);
+        for(int i= 0; i< TraceGetCommSize(what); ++i) {
+          const int q= TraceGetCommRank(what, i);
+          if(q!= ip&& !CollMemberHasLeft(what, q, seq)) {
+            WaitForAddEdge(ip, q);
+          }
+        }
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+static void reportBlockedRank(const int p, const bool *const completed)
+{
+  const long what= WaitForGetWhat(p);
+  switch(WaitForGetReason(p)) {
+  case WAIT_RECV:
+  case WAIT_SEND: {
+      const double *const st= TraceGetPtrMsgSendAt(what, 0);
+      const double *const rt= TraceGetPtrMsgRecvAt(what, 0);
+      const int remote= WAIT_RECV== WaitForGetReason(p)?
+                        TraceGetMsgSendRank(what): TraceGetMsgRecvRank(what);
+      Error("  rank-%d: %s -> %s at %.0lf: %s msg-%ld %d->%d (send %.0lf:%.0lf, recv %.0lf:%.0lf, %.0lf B, tag %d)%s\n",
+            p, pevtname(p), cevtname(p), tcevt(p),
+            WAIT_RECV== WaitForGetReason(p)? "recv": "rendezvous send", what,
+            TraceGetMsgSendRank(what), TraceGetMsgRecvRank(what), st[0], st[1],
+            rt[0], rt[1], TraceGetMsgSize(what), *TraceGetPtrMsgTag(what),
+            completed[remote]? " - remote completed": "");
+    }
+    break;
+  case WAIT_COLL:
+  case WAIT_COLL_BUSY: {
+      int nwaits= 0;
+      for(int e= WaitFor.head[p]; -1!= e; e= WaitFor.next[e]) {
+        ++nwaits;
+      }
+      Error("  rank-%d: %s -> %s at %.0lf: %s %s on comm-%ld, waits for %d/%d members\n",
+            p, pevtname(p), cevtname(p), tcevt(p),
+            WAIT_COLL== WaitForGetReason(p)? "leaving": "entering",
+            WAIT_COLL== WaitForGetReason(p)? pevtname(p): cevtname(p), what,
+            nwaits, TraceGetCommSize(what));
+    }
+    break;
+  default:
+    Error("  rank-%d: %s -> %s at %.0lf: unknown reason\n", p, pevtname(p),
+          cevtname(p), tcevt(p));
+    break;
+  }
+}
+static void reportStall(const int np, const bool *const completed)
+{
+  int nblocked= 0, nends= 0;
+  for(int ip= 0; ip< np; ++ip) {
+    if(!completed[ip]) {
+      ++nblocked;
+      if(WaitForIsInvolved(ip)&& -1== WaitForGetComp(ip)) {
+        ++nends;
+      }
+    }
+  }
+  Error("Replay cannot progress: %d/%d ranks blocked, %d wait-for cycle(s), %d rank(s) wait for completed ranks\n",
+        nblocked, np, WaitForGetNumComps(), nends);
+  int nreported= 0;
+  for(int ic= 0; ic< WaitForGetNumComps(); ++ic) {
+    Error("wait-for cycle-%d:\n", ic);
+    for(int ip= 0; ip< np; ++ip) {
+      if(ic== WaitForGetComp(ip)) {
+        reportBlockedRank(ip, completed);
+        ++nreported;
+      }
+    }
+  }
+  if(nends> 0) {
+    Error("waiting for completed ranks:\n");
+    for(int ip= 0; ip< np; ++ip) {
+      if(WaitForIsInvolved(ip)&& -1== WaitForGetComp(ip)) {
+        reportBlockedRank(ip, completed);
+        ++nreported;
+      }
+    }
+  }
+  if(nblocked> nreported) {
+    Error("%d other rank(s) blocked behind these\n", nblocked- nreported);
+  }
+}
+/* returns 0 if the replay can continue with the illogical receives of the
+ * involved ranks halted, 1 if it is stuck for good
+ */
+static int resolveStall(const int np, const bool *const completed)
+{
+  buildWaitForGraph(np, completed);
+  const int ninvolved= WaitForAnalyse(completed);
+
+  bool illogical= false;
+  for(int ip= 0; ip< np&& !illogical; ++ip) {
+    if(!WaitForIsInvolved(ip)|| WAIT_RECV!= WaitForGetReason(ip)) {
+      continue;
+    }
+    IndexList *ixr= TraceGetCurrProcEvtRecvs(ip, 1);
+    for(; NULL!= ixr&& !illogical; ixr= ixr->next) {
+      illogical= !settled(TraceGetProcRecvAts(ip, ixr->i))&& rillogical(ip,
+                 ixr->i);
+    }
+  }
+
+  if(nstucks> 1|| 0== ninvolved|| !illogical) {
+    reportStall(np, completed);
+    return 1;
+  }
+  Log1("Stuck: halting illogical receives on %d involved rank(s)\n",
+       ninvolved);
+  return 0;
+}
+
+/* Partitioned replay: forked workers sweep contiguous blocks of ranks with
+ * the replay state in shared memory. Posts, settles and collective entries
+ * of other workers are seen through the shared stamps; a worker sweeping
+ * without progress waits for the others. The workers stop once their ranks
+ * completed, or once none of them progresses anymore: the serial loop then
+ * resolves the stall and continues from there.
+ */
+#define WORKER_BUSY -1L
+#define WORKER_DONE LONG_MAX
+typedef struct {
+  long progress;                /* #sweeps with progress, all workers */
+  int n;                        /* #workers */
+  long idle[];                  /* progress at the last idle sweep, or busy/done */
+} Workers;
+
+static bool workersStalled(const Workers *const w, const int nworkers,
+                           const long progress)
+{
+  for(int k= 0; k< nworkers; ++k) {
+    const long idle= ShmLoadLong(w->idle+ k);
+    if(WORKER_DONE!= idle&& progress!= idle) {
+      return false;
+    }
+  }
+  return progress== ShmLoadLong(&w->progress);
+}
+static void replayPartition(const int k, const int p0, const int p1,
+                            void *const arg)
+{
+  Workers *const w= (Workers *) arg;
+  const int nworkers= w->n;
+  bool *completed= (bool *) malloc(sizeof(bool)* TraceGetNumProcs());
+  int ncompleted= 0;
+  for(int ip= p0; ip< p1; ++ip) {
+    ncompleted+= checkEvtsCompletion(ip, completed);
+  }
+
+  while(ncompleted< p1- p0) {
+    const long progress= ShmLoadLong(&w->progress);
+    ShmStoreLong(w->idle+ k, WORKER_BUSY);
+
+    long movement= 0;
+    nchanges= 0;
+    for(int ip= p0; ip< p1; ++ip) {
+      if(completed[ip]) {
+        continue;
+      }
+      movement+= processRank(ip);
+      ncompleted+= checkEvtsCompletion(ip, completed);
+    }
+
+    if(0!= movement|| 0!= nchanges) {
+      ShmAddLong(&w->progress, 1);
+      continue;
+    }
+    ShmStoreLong(w->idle+ k, progress);
+    if(workersStalled(w, nworkers, progress)) {
+      Debug1("worker-%d: no worker progresses, ranks %d-%d\n", k, p0, p1- 1);
+      break;
+    }
+    sched_yield();
+  }
+  ShmStoreLong(w->idle+ k, WORKER_DONE);
+
+  FREE_IF(completed);
+}
+/* the ranks of a worker not forked are left to the serial loop */
+static void replayUnforked(const int k, const int p0, const int p1,
+                           void *const arg)
+{
+  (void) p0; (void) p1;
+  ShmStoreLong(((Workers *) arg)->idle+ k, WORKER_DONE);
+}
+/* returns 0 if the workers finished, 1 if any of them failed */
+static int replayWorkers(const int nworkers)
+{
+  ClockShare();
+  TraceShareReplayState();
+  CollsShare();
+  WhatIfShare();
+  const size_t size= sizeof(Workers)+ sizeof(long)* nworkers;
+  Workers *w= ShmAlloc(size);
+  w->n= nworkers;
+  for(int k= 0; k< nworkers; ++k) {
+    w->idle[k]= WORKER_BUSY;
+  }
+
+  int *first= (int *) malloc(sizeof(int)* (nworkers+ 1));
+  TracePartitionProcs(nworkers, first);
+  const int ret= ShmRunWorkers(nworkers, first, replayPartition, replayUnforked,
+                               w)> 0? 1: 0;
+  Log1("%ld sweeps with progress by %d workers\n", w->progress, nworkers);
+
+  FREE_IF(first);
+  ShmFree(w, size);
+  WhatIfUnshare();
+  CollsUnshare();
+  TraceUnshareReplayState();
+  ClockUnshare();
+
+  return ret;
+}
+
+/* returns 0 on completion, 1 if the replay got stuck */
+static int processTrace()
 {
   /* calcMonRanksTimepoints(NULL, NULL, NULL); */
+  if(SKEW_NONE!= GlOpts.sim_opts.skew) {
+    const double t= Timer_s();
+    CorrectClockSkew(GlOpts.sim_opts.skew);
+    if(GlOpts.show_opts.timings) {
+      printf("Clock-skew correction took %.1lf s\n", Timer_s()- t);
+    }
+  }
   const double t0= Timer_s();
   TraceConnectEvtsToMsgs();
   if(GlOpts.show_opts.timings) {
     printf("Connecting MPI events to p2p calls took %.1lf s\n", Timer_s()- t0);
   }
+  if(GlOpts.show_opts.diag< 1) {  /* per-event reviews need the slow path */
+    TraceMarkProcSpans(clockOnlyEvt);
+  }
 
   const int np= TraceGetNumProcs();
+  if(np< 1) {
+    Error("No process to replay\n");
+    return 1;
+  }
+  classifyMsgs(np);
+  WhatIfInit(np);
+  NetInit(np);
 
   initialiseClocks(np);
   initialiseCollectives(np);
+  initialiseWaitFor(np);
+  if(GlOpts.online_mon) {
+    MonitorInit(np);
+  }
 
   TraceResetProcIters();
 
   playMPI_Init(np);
 
+  const int nworkers= MIN(GlOpts.sim_opts.nworkers, np);
+  if(nworkers> 1&& 0!= replayWorkers(nworkers)) {
+    Error("Wrong results!!\n");
+    WaitForFinalize();
+    return 1;
+  }
+
   int ncompleted= 0;
   bool *completed= (bool *) malloc(sizeof(bool)* np);
   for(int ip= 0; ip< np; ++ip) {
     ncompleted+= checkEvtsCompletion(ip, completed);
   }
 
-  long *ix= (long *) malloc(sizeof(long)* np);
-  memset(ix, 0, sizeof(long)* np);
-
-  const int maxstucks= np;
+  int ret= 0;
   while(ncompleted< np) {       /* main loop over events records */
-    int movement= 0;
+    long movement= 0;
+    nchanges= 0;
     for(int ip= 0; ip< np; ++ip) {
       if(completed[ip]) {
         Debug1("%d: events completed, skipping\n", ip);
@@ -576,19 +1026,20 @@ static void processTrace()
       ncompleted+= checkEvtsCompletion(ip, completed);
     }
 
-    if(0== movement&& false) {
+    if(0== movement&& 0== nchanges) {
       Debug1("This iteration has not progressed\n");
       ++nstucks;
-      if(nstucks> maxstucks- 1) {
-        Error("All are stuck for %d iterations, getting out\n", maxstucks);
+      if(0!= resolveStall(np, completed)) {
+        ret= 1;
         break;
       }
-    } else {
+    } else if(nstucks> 0) {
       nstucks= 0;
+      WaitForResetGraph();
     }
   }
 
-  if(maxstucks!= nstucks) {
+  if(0== ret) {
 #if 0
     bool appEnds= false;        /* 40000001:0 doesn't exist */
     for(int ip= 0; ip< np; ++ip) {
@@ -613,8 +1064,124 @@ static void processTrace()
   } else {
     Error("Wrong results!!\n");
   }
+
+  FREE_IF(completed);
+  FREE_IF(Span.crit); Span.len= 0;
+  WaitForFinalize();
+
+  return ret;
+}
+
+/* ideal runtimes of the what-if lanes next to the recorded one */
+static void showWhatIfs(const int np, const double ideal)
+{
+  const int nl= WhatIfGetFirstReplica();  /* replicas are summarised */
+  if(nl< 2) {
+    return;
+  }
+  const double n2u= 1.0e-3;
+
+  FILE *fp= stdout;
+  if(GlOpts.show_opts.pretty) {
+    fprintf(fp, "What-if                           | %10s", WhatIfGetLaneLabel(0));
+    for(int l= 1; l< nl; ++l) {
+      fprintf(fp, " %10s", WhatIfGetLaneLabel(l));
+    }
+    fprintf(fp, "\n");
+    fprintf(fp, "-- Ideal runtime [us]             | %10.2lf", ideal);
+    for(int l= 1; l< nl; ++l) {
+      fprintf(fp, " %10.2lf", ClockGetMaxLaneCritical(l, np)* n2u);
+    }
+    fprintf(fp, "\n");
+    fprintf(fp, "-- Speed-up                       | %10.2lf", 1.0);
+    for(int l= 1; l< nl; ++l) {
+      fprintf(fp, " %10.2lf", ideal/ (ClockGetMaxLaneCritical(l, np)* n2u));
+    }
+    fprintf(fp, "\n");
+    fprintf(fp, "==============================================\n");
+  } else {
+    fprintf(fp, "whatif=");
+    for(int l= 1; l< nl; ++l) {
+      fprintf(fp, "%s %s: %.2lf us", 1== l? "": ",", WhatIfGetLaneLabel(l),
+              ClockGetMaxLaneCritical(l, np)* n2u);
+    }
+    fprintf(fp, "\n");
+  }
 }
+/* spread of the ideal runtimes of the noise replicas, and the ranks whose
+ * noise adds most to them: the slope of the runtime over the noise of a rank
+ */
+static void showNoise(const int np, const double ideal)
+{
+  const int n= WhatIfGetNumReplicas();
+  if(n< 1) {
+    return;
+  }
+  const int l0= WhatIfGetFirstReplica();
+  const double n2u= 1.0e-3;
+
+  double *runtime= (double *) malloc(sizeof(double)* n);
+  double *sorted= (double *) malloc(sizeof(double)* n);
+  double mean= 0.0;
+  for(int i= 0; i< n; ++i) {
+    runtime[i]= sorted[i]= ClockGetMaxLaneCritical(l0+ i, np)* n2u;
+    mean+= runtime[i]/ n;
+  }
+  qsort(sorted, n, sizeof(double), CmpDoubles);
+  static const double q[3]= { 0.05, 0.5, 0.95 };
+  double pct[3];
+  for(int k= 0; k< 3; ++k) {
+    pct[k]= sorted[MAX((int) ceil(q[k]* n)- 1, 0)];
+  }
+
+  double *gain= (double *) malloc(sizeof(double)* np);
+  for(int ip= 0; ip< np; ++ip) {
+    double nmean= 0.0;
+    for(int i= 0; i< n; ++i) {
+      nmean+= WhatIfGetNoise(l0+ i, ip)* n2u/ n;
+    }
+    double cov= 0.0, var= 0.0;
+    for(int i= 0; i< n; ++i) {
+      const double dn= WhatIfGetNoise(l0+ i, ip)* n2u- nmean;
+      cov+= (runtime[i]- mean)* dn;
+      var+= dn* dn;
+    }
+    gain[ip]= var> 0.0? cov/ var: 0.0;
+  }
 
+  FILE *fp= stdout;
+  if(GlOpts.show_opts.pretty) {
+    fprintf(fp, "Noise (%s, %d replicas)\n", GlOpts.sim_opts.whatif.noise, n);
+    fprintf(fp, "                                  | %10s %10s %10s %10s %10s\n",
+            "mean", "p5", "p50", "p95", "max");
+    fprintf(fp, "-- Ideal runtime [us]             | %10.2lf %10.2lf %10.2lf %10.2lf %10.2lf\n",
+            mean, pct[0], pct[1], pct[2], sorted[n- 1]);
+    fprintf(fp, "-- Slow-down                      | %10.4lf %10.4lf %10.4lf %10.4lf %10.4lf\n",
+            mean/ ideal, pct[0]/ ideal, pct[1]/ ideal, pct[2]/ ideal,
+            sorted[n- 1]/ ideal);
+    fprintf(fp, "-- Noise gain of ranks            |");
+  } else {
+    fprintf(fp, "noise= mean: %.2lf us, p5: %.2lf us, p50: %.2lf us, p95: %.2lf us, max: %.2lf us\n",
+            mean, pct[0], pct[1], pct[2], sorted[n- 1]);
+    fprintf(fp, "noise-gain=");
+  }
+  for(int k= 0; k< MIN(5, np); ++k) {  /* highest first */
+    int pmax= 0;
+    for(int ip= 1; ip< np; ++ip) {
+      pmax= gain[ip]> gain[pmax]? ip: pmax;
+    }
+    fprintf(fp, "%s %d: %.2lf", 0== k? "": ",", pmax, gain[pmax]);
+    gain[pmax]= -DBL_MAX;
+  }
+  fprintf(fp, "\n");
+  if(GlOpts.show_opts.pretty) {
+    fprintf(fp, "==============================================\n");
+  }
+
+  FREE_IF(gain);
+  FREE_IF(sorted);
+  FREE_IF(runtime);
+}
 static void showStats()
 {
   const int np= TraceGetNumProcs();
@@ -677,6 +1244,28 @@ static void showStats()
             useful_avg* runtime_inv, useful_avg/ useful_max,
             useful_max/ runtime_traced_ideal, runtime_traced_ideal* runtime_inv);
   }
+  showWhatIfs(np, runtime_traced_ideal);
+  showNoise(np, runtime_traced_ideal);
+}
+
+static void showProtocols()
+{
+  long nmsgs= 0;
+  double nbytes= 0.0;
+  for(int k= 0; k< MSG_NUM_PROTOS; ++k) {
+    nmsgs+= Protos.nmsgs[k];
+    nbytes+= Protos.nbytes[k];
+  }
+
+  FILE *fp= stdout;
+  fprintf(fp, "%12s %12s %8s %16s %8s\n", "protocol", "#messages", "%",
+          "bytes", "%");
+  for(int k= 0; k< MSG_NUM_PROTOS; ++k) {
+    fprintf(fp, "%12s %12ld %8.2lf %16.0lf %8.2lf\n", protoname(k),
+            Protos.nmsgs[k], nmsgs> 0? Protos.nmsgs[k]* 100.0/ nmsgs: 0.0,
+            Protos.nbytes[k],
+            nbytes> 0.0? Protos.nbytes[k]* 100.0/ nbytes: 0.0);
+  }
 }
 
 inline static void PrintGlobalOpts()
@@ -689,16 +1278,45 @@ inline static void PrintGlobalOpts()
   printf("    io_timings: %s\n", GlOpts.show_opts.timings? "true": "false");
   printf("    profile: %s\n", GlOpts.show_opts.profile? "true": "false");
   printf("    pretty: %s\n", GlOpts.show_opts.pretty? "true": "false");
+  printf("    protocols: %s\n", GlOpts.show_opts.protocols? "true": "false");
   printf("\n  win_mon:\n");
-  printf("    win_len: %.6e\n", GlOpts.win_mon.win_len);
+  printf("    win_len:");
+  for(int i= 0; i< GlOpts.win_mon.nwin_lens; ++i) {
+    printf(" %.6e", GlOpts.win_mon.win_len[i]);
+  }
+  printf("\n");
   printf("    nwins_sma: %d\n", GlOpts.win_mon.nwins_sma);
+  printf("    ema: %.3lf\n", GlOpts.win_mon.ema);
+  printf("    adapt: %s\n", NULL!= GlOpts.win_mon.adapt? GlOpts.win_mon.adapt: "-");
+  printf("    heatmap: %d\n", GlOpts.win_mon.heatmap);
+  printf("    ideal: %s\n", GlOpts.win_mon.ideal? "true": "false");
   printf("    enabled: %s\n", GlOpts.win_mon.enabled? "true": "false");
   printf("  \n  evt_mon:\n");
   printf("    rank: %d\n", GlOpts.evt_mon.rank);
+  printf("    ranks: %s\n", NULL!= GlOpts.evt_mon.ranks? GlOpts.evt_mon.ranks: "-");
   printf("    nevts_report: %d\n", GlOpts.evt_mon.nevts_report);
   printf("    enabled: %s\n", GlOpts.evt_mon.enabled? "true": "false");
+  printf("  online_mon: %s\n", GlOpts.online_mon? "true": "false");
   printf("  \n  sim_opts:\n");
   printf("    eager_limit: %.0lf\n", GlOpts.sim_opts.eager_limit);
+  printf("    nworkers: %d\n", GlOpts.sim_opts.nworkers);
+  printf("    ranks: %s\n", NULL!= GlOpts.sim_opts.ranks? GlOpts.sim_opts.ranks: "all");
+  printf("    skew: %d\n", GlOpts.sim_opts.skew);
+  printf("    inter_latency: %.3e\n", GlOpts.sim_opts.net.latency);
+  printf("    inter_bandwidth: %.3e\n", GlOpts.sim_opts.net.bandwidth);
+  printf("    loggp: %.3e, %.3e, %.3e, %.3e\n", GlOpts.sim_opts.loggp[0],
+         GlOpts.sim_opts.loggp[1], GlOpts.sim_opts.loggp[2],
+         GlOpts.sim_opts.loggp[3]);
+  printf("    coll_algs: %s\n", NULL!= GlOpts.sim_opts.coll_algs? GlOpts.sim_opts.coll_algs: "default");
+  printf("    whatif:\n");
+  printf("      factors: %s\n", NULL!= GlOpts.sim_opts.whatif.factors? GlOpts.sim_opts.whatif.factors: "none");
+  printf("      ranks: %s\n", NULL!= GlOpts.sim_opts.whatif.ranks? GlOpts.sim_opts.whatif.ranks: "all");
+  printf("      region: %lld:%lld\n", GlOpts.sim_opts.whatif.region[0],
+         GlOpts.sim_opts.whatif.region[1]);
+  printf("      balance: %s\n", GlOpts.sim_opts.whatif.balance? "true": "false");
+  printf("      noise: %s\n", NULL!= GlOpts.sim_opts.whatif.noise? GlOpts.sim_opts.whatif.noise: "none");
+  printf("      nreplicas: %d\n", GlOpts.sim_opts.whatif.nreplicas);
+  printf("      seed: %lu\n", GlOpts.sim_opts.whatif.seed);
   printf("    ignore:\n");
   printf("      trace_evts: %s\n",
          GlOpts.sim_opts.ignore.trace_evts? "true": "false");
@@ -888,6 +1506,7 @@ int main(int argc, char *argv[])
 {
   if(0!= ParseArgs(argc, argv)) {
     ArgHelp();
+    ArgFree();
     return 0;
   }
   PrintGlobalOpts();
@@ -898,6 +1517,7 @@ int main(int argc, char *argv[])
   const double t0= Timer_s();
   if(0!= ReadParaverFile(GlOpts.filename)) {
     Error("Problem reading paraver file \"%s\"\n", argv[1]);
+    ArgFree();
     return 0;
   }
   const double t1= Timer_s();
@@ -906,7 +1526,13 @@ int main(int argc, char *argv[])
     printf("Reading Paraver file took %.1lf s\n", t1- t0);
   }
 
-  processTrace();
+  if(0!= processTrace()) {
+    NetFinalize();
+    ClockFinalize();
+    WhatIfFinalize();
+    ArgFree();
+    return 1;
+  }
   if(false) {
     FILE *fp= fopen("checking.txt", "w");
     for(TraceResetIterEvts(); TraceGetIterEvts()< TraceGetNumEvts();
@@ -918,23 +1544,32 @@ int main(int argc, char *argv[])
   }
 
   showStats();
+  if(GlOpts.show_opts.protocols) {
+    showProtocols();
+  }
 
+  NetFinalize();
   ClockFinalize();
+  WhatIfFinalize();
 
   if(GlOpts.show_opts.timings) {
     const double t2= Timer_s();
     printf("Replay took %.1lf s (total %.1lf s)\n", t2- t1, t2- t0);
   }
 
-  if(GlOpts.evt_mon.enabled) {
-    DoMonitoringEventBased();
-  }
+  if(GlOpts.online_mon) {
+    MonitorFinalize();
+  } else {
+    if(GlOpts.evt_mon.enabled) {
+      DoMonitoringEventBased();
+    }
 
-  if(GlOpts.win_mon.enabled) {
-    DoMonitoringWindowed();
+    if(GlOpts.win_mon.enabled) {
+      DoMonitoringWindowed();
+    }
   }
 
-  FREE_IF(GlOpts.filename);
+  ArgFree();
 
   return 0;
 }
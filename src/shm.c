@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2025      High Performance Computing Center Stuttgart,
+ *                         University of Stuttgart.  All rights reserved.
+ *
+ * Authors: Kingshuk Haldar <kingshuk.haldar@hlrs.de>
+ *
+ */
+
+#include"shm.h"
+#include"common.h"
+#include"utils.h"
+#include<stdlib.h>
+#include<string.h>
+#include<fcntl.h>
+#include<stdio.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/types.h>
+#include<sys/wait.h>
+
+/* zero-filled; mapping /dev/zero shared keeps it visible across fork() */
+void *ShmAlloc(const size_t size)
+{
+  const int fd= open("/dev/zero", O_RDWR);
+  if(fd< 0) {
+    Error("Cannot open /dev/zero for shared memory\n");
+    exit(EXIT_FAILURE);
+  }
+  void *ptr= mmap(NULL, size, PROT_READ| PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(MAP_FAILED== ptr) {
+    Error("Cannot map %zu bytes of shared memory\n", size);
+    exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+void ShmFree(void *const ptr, const size_t size)
+{
+  if(NULL!= ptr&& size> 0) {
+    munmap(ptr, size);
+  }
+}
+
+/* moves size bytes from malloc-ed memory to shared memory */
+void *ShmFromHeap(void *const heap, const size_t size)
+{
+  if(0== size) {
+    return heap;
+  }
+  void *shm= ShmAlloc(size);
+  memcpy(shm, heap, size);
+  free(heap);
+  return shm;
+}
+/* moves size bytes from shared memory back to malloc-ed memory */
+void *ShmToHeap(void *const shm, const size_t size)
+{
+  if(0== size) {
+    return shm;
+  }
+  void *heap= malloc(size);
+  memcpy(heap, shm, size);
+  ShmFree(shm, size);
+  return heap;
+}
+
+int ShmRunWorkers(const int nworkers, const int *const first, ShmWork run,
+                  ShmWork unforked, void *const arg)
+{
+  fflush(stdout);
+  pid_t *pids= (pid_t *) malloc(sizeof(pid_t)* nworkers);
+  for(int k= 0; k< nworkers; ++k) {
+    pids[k]= fork();
+    if(0== pids[k]) {
+      run(k, first[k], first[k+ 1], arg);
+      fflush(stdout);
+      _exit(0);
+    }
+    if(pids[k]< 0) {
+      Error("Cannot fork worker-%d for ranks %d-%d\n", k, first[k],
+            first[k+ 1]- 1);
+      unforked(k, first[k], first[k+ 1], arg);
+    }
+  }
+
+  int nfailed= 0;
+  for(int k= 0; k< nworkers; ++k) {
+    int status= 0;
+    if(pids[k]> 0&& (waitpid(pids[k], &status, 0)!= pids[k]||
+                     !WIFEXITED(status)|| 0!= WEXITSTATUS(status))) {
+      Error("Worker-%d for ranks %d-%d failed\n", k, first[k], first[k+ 1]- 1);
+      ++nfailed;
+    }
+  }
+  FREE_IF(pids);
+  return nfailed;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2025      High Performance Computing Center Stuttgart,
+ *                         University of Stuttgart.  All rights reserved.
+ *
+ * Authors: Kingshuk Haldar <kingshuk.haldar@hlrs.de>
+ *
+ */
+
+#ifndef REPLAY_SHM_H__
+#define REPLAY_SHM_H__
+
+#include<stddef.h>
+#include<stdbool.h>
+
+/* Memory shared with the forked workers of a partitioned replay.
+ * Arrays are moved from the heap into a shared mapping before forking and
+ * back after the workers are done, so that their owners can keep using
+ * (and freeing) them as usual.
+ */
+extern void *ShmAlloc(const size_t);
+extern void ShmFree(void *const, const size_t);
+extern void *ShmFromHeap(void *const, const size_t);
+extern void *ShmToHeap(void *const, const size_t);
+
+/* Forked workers over blocks of ranks: worker k runs run(k, first[k],
+ * first[k+ 1], arg). For a worker that cannot be forked, unforked is called
+ * instead, in the calling process. Returns #workers that failed.
+ */
+typedef void (*ShmWork)(const int, const int, const int, void *const);
+extern int ShmRunWorkers(const int, const int *const, ShmWork, ShmWork,
+                         void *const);
+
+/* accesses to state written by more than one worker */
+inline static long ShmLoadLong(const long *const x) { return __atomic_load_n(x, __ATOMIC_ACQUIRE); }
+inline static void ShmStoreLong(long *const x, const long v) { __atomic_store_n(x, v, __ATOMIC_RELEASE); }
+inline static long ShmAddLong(long *const x, const long v) { return __atomic_add_fetch(x, v, __ATOMIC_ACQ_REL); }
+inline static int ShmLoadInt(const int *const x) { return __atomic_load_n(x, __ATOMIC_ACQUIRE); }
+inline static int ShmAddInt(int *const x, const int v) { return __atomic_add_fetch(x, v, __ATOMIC_ACQ_REL); }
+inline static bool ShmSwapIntIf(int *const x, int *const expected,
+                                const int v) { return __atomic_compare_exchange_n(x, expected, v, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE); }
+inline static double ShmLoadDouble(double *const x)
+{
+  double v;
+  __atomic_load(x, &v, __ATOMIC_ACQUIRE);
+  return v;
+}
+inline static void ShmStoreDouble(double *const x, double v) { __atomic_store(x, &v, __ATOMIC_RELEASE); }
+inline static void ShmMaxDouble(double *const x, double v)
+{
+  double curr= ShmLoadDouble(x);
+  while(v> curr&& !__atomic_compare_exchange(x, &curr, &v, false,
+                                             __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    ;
+  }
+}
+inline static void ShmMinDouble(double *const x, double v)
+{
+  double curr= ShmLoadDouble(x);
+  while(v< curr&& !__atomic_compare_exchange(x, &curr, &v, false,
+                                             __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    ;
+  }
+}
+
+#endif  /* REPLAY_SHM_H__ */
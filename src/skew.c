@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2025      High Performance Computing Center Stuttgart,
+ *                         University of Stuttgart.  All rights reserved.
+ *
+ * Authors: Kingshuk Haldar <kingshuk.haldar@hlrs.de>
+ *
+ */
+
+#include"skew.h"
+#include"common.h"
+#include"utils.h"
+#include"trace_data.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+inline static int clockOf(const int domain, const int p) { return SKEW_PER_NODE== domain? TraceGetProcNode(p): p; }
+
+/* by how much the receive ends before its send starts, both shifted */
+inline static double lag(const long g, const double *const off,
+                         const int cs, const int cr)
+{
+  return (TraceGetMsgSendAt(g, 0)+ off[cs])- (TraceGetMsgRecvAt(g, 1)+ off[cr]);
+}
+
+/* counts the receives ending before their sends start */
+static long countIllogical(const int domain, const double *const off)
+{
+  long n= 0;
+  for(long g= 0; g< TraceGetNumMsgs(); ++g) {
+    const int s= TraceGetMsgSendRank(g), r= TraceGetMsgRecvRank(g);
+    if(s< 0|| r< 0) {
+      continue;  /* an end left out of the replay */
+    }
+    if(lag(g, off, clockOf(domain, s), clockOf(domain, r))> 0.0) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+/* the constraints between two clocks: the largest lag of their messages */
+typedef struct {
+  int to;
+  double lag;
+} SkewEdge;
+
+static int cmpSkewEdges(const void *a, const void *b)
+{
+  const SkewEdge *const x= (const SkewEdge *) a, *const y= (const SkewEdge *) b;
+  if(x->to!= y->to) {
+    return x->to< y->to? -1: 1;
+  }
+  return x->lag> y->lag? -1: (x->lag< y->lag? 1: 0);
+}
+
+/* edges out of clock c are edges[first[c]..first[c+1]-1] */
+static SkewEdge *skewEdges(const int domain, const int nclks, long *const first)
+{
+  const double zero[1]= { 0.0 };
+  memset(first, 0, sizeof(long)* (nclks+ 1));
+  for(long g= 0; g< TraceGetNumMsgs(); ++g) {
+    const int s= TraceGetMsgSendRank(g), r= TraceGetMsgRecvRank(g);
+    if(s>= 0&& r>= 0&& clockOf(domain, s)!= clockOf(domain, r)) {
+      ++first[clockOf(domain, s)+ 1];
+    }
+  }
+  for(int c= 0; c< nclks; ++c) {
+    first[c+ 1]+= first[c];
+  }
+  long *fill= (long *) malloc(sizeof(long)* nclks);
+  memcpy(fill, first, sizeof(long)* nclks);
+  SkewEdge *edges= (SkewEdge *) malloc(sizeof(SkewEdge)* MAX(first[nclks], 1));
+  for(long g= 0; g< TraceGetNumMsgs(); ++g) {
+    const int s= TraceGetMsgSendRank(g), r= TraceGetMsgRecvRank(g);
+    if(s>= 0&& r>= 0&& clockOf(domain, s)!= clockOf(domain, r)) {
+      SkewEdge *const e= edges+ fill[clockOf(domain, s)]++;
+      e->to= clockOf(domain, r);
+      e->lag= lag(g, zero, 0, 0);
+    }
+  }
+  FREE_IF(fill);
+
+  long n= 0;
+  for(int c= 0; c< nclks; ++c) {  /* the largest lag per pair of clocks */
+    const long b= first[c], e= first[c+ 1];
+    qsort(edges+ b, e- b, sizeof(SkewEdge), cmpSkewEdges);
+    first[c]= n;
+    for(long i= b; i< e; ++i) {
+      if(i== b|| edges[i].to!= edges[i- 1].to) {
+        edges[n++]= edges[i];
+      }
+    }
+  }
+  first[nclks]= n;
+  return edges;
+}
+
+/* The offsets are the least non-negative solution of
+ *   off[recv-clock]>= off[send-clock]+ send-start- recv-end
+ * over all messages, i.e. receivers are only moved forward and only as much
+ * as needed: the longest paths in the graph of the clocks with the largest
+ * lag per pair of them as edges. They are relaxed in Bellman-Ford order from
+ * a queue of the clocks moved, till none moves: O(#clocks* #edges) at worst,
+ * a few passes over the edges for traces with few contradictions. A clock
+ * whose offset comes along a path of #clocks edges or more has a repeated
+ * clock on it, i.e. a cycle of contradicting messages, which no offsets
+ * satisfy: then no clock is shifted. Returns #updates of offsets, -1 for a
+ * cycle.
+ */
+static long skewOffsets(const int domain, const int nclks, double *const off)
+{
+  long *first= (long *) malloc(sizeof(long)* (nclks+ 1));
+  SkewEdge *edges= skewEdges(domain, nclks, first);
+
+  int *queue= (int *) malloc(sizeof(int)* nclks);
+  int *len= (int *) malloc(sizeof(int)* nclks);      /* #edges of the path */
+  bool *queued= (bool *) malloc(sizeof(bool)* nclks);
+  memset(len, 0, sizeof(int)* nclks);
+  int head= 0, nqueued= 0;
+  for(int c= 0; c< nclks; ++c) {
+    queued[c]= first[c+ 1]> first[c];
+    if(queued[c]) {
+      queue[nqueued++]= c;
+    }
+  }
+  long nupdates= 0;
+  while(nqueued> 0&& nupdates>= 0) {
+    const int c= queue[head];
+    head= head+ 1== nclks? 0: head+ 1;
+    --nqueued;
+    queued[c]= false;
+    for(long i= first[c]; i< first[c+ 1]; ++i) {
+      const int d= edges[i].to;
+      if(off[c]+ edges[i].lag<= off[d]) {
+        continue;
+      }
+      off[d]= off[c]+ edges[i].lag;
+      ++nupdates;
+      len[d]= len[c]+ 1;
+      if(len[d]>= nclks) {
+        nupdates= -1;
+        break;
+      }
+      if(!queued[d]) {
+        queued[d]= true;
+        queue[(head+ nqueued++)% nclks]= d;
+      }
+    }
+  }
+
+  FREE_IF(queued);
+  FREE_IF(len);
+  FREE_IF(queue);
+  FREE_IF(edges);
+  FREE_IF(first);
+  return nupdates;
+}
+
+long CorrectClockSkew(const int domain)
+{
+  const int np= TraceGetNumProcs();
+  const int nclks= SKEW_PER_NODE== domain? TraceGetNumNodes(): np;
+  double *off= (double *) malloc(sizeof(double)* nclks);
+  memset(off, 0, sizeof(double)* nclks);
+
+  const long nbefore= countIllogical(domain, off);
+  const long nupdates= nbefore> 0? skewOffsets(domain, nclks, off): 0;
+  if(nupdates< 0) {
+    Error("Clock-skew correction: messages contradict along a cycle of clocks,"
+          " no clock shifted\n");
+    memset(off, 0, sizeof(double)* nclks);
+  }
+
+  int nshifted= 0;
+  double maxoff= 0.0;
+  for(int c= 0; c< nclks; ++c) {
+    if(off[c]> 0.0) {
+      ++nshifted;
+      maxoff= MAX(off[c], maxoff);
+      Debug1("clock-%d: shifted by %.0lf ns\n", c, off[c]);
+    }
+  }
+  if(nshifted> 0) {
+    for(int ip= 0; ip< np; ++ip) {
+      const double dt= off[clockOf(domain, ip)];
+      if(dt> 0.0) {
+        TraceShiftProcTimes(ip, dt);
+      }
+    }
+    TraceCalculateTimelineExtremes();
+  }
+  memset(off, 0, sizeof(double)* nclks);  /* the times are shifted now */
+  const long nafter= countIllogical(domain, off);
+
+  printf("Clock-skew correction (per %s): %d of %d clocks shifted by up to %.0lf ns"
+         " in %ld updates, illogical receives %ld -> %ld\n",
+         SKEW_PER_NODE== domain? "node": "rank", nshifted, nclks, maxoff,
+         MAX(nupdates, 0), nbefore, nafter);
+
+  FREE_IF(off);
+  return nafter;
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2025      High Performance Computing Center Stuttgart,
+ *                         University of Stuttgart.  All rights reserved.
+ *
+ * Authors: Kingshuk Haldar <kingshuk.haldar@hlrs.de>
+ *
+ */
+
+#ifndef REPLAY_SKEW_H__
+#define REPLAY_SKEW_H__
+
+#include<stdbool.h>
+
+/* clock domains of a skew correction */
+#define SKEW_NONE 0
+#define SKEW_PER_RANK 1
+#define SKEW_PER_NODE 2
+
+/* Shifts the recorded times of every clock domain by a constant offset so that
+ * no receive ends before its send starts, i.e. no illogical receive remains to
+ * be halted during the replay. Returns #illogical receives left uncorrected.
+ */
+extern long CorrectClockSkew(const int);
+
+#endif  /* REPLAY_SKEW_H__ */
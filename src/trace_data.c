@@ -10,9 +10,11 @@
 #include"utils.h"
 #include"paraver_file.h"
 #include"trace_data.h"
+#include"shm.h"
 #include<stdlib.h>
 #include<string.h>
 #include<stdbool.h>
+#include<limits.h>
 
 inline static void allocComms(TraceData *const t, const int numComms,
                               const long sizeAllComms)
@@ -23,6 +25,113 @@ inline static void allocComms(TraceData *const t, const int numComms,
   t->comms.ranks= (int **) malloc(sizeof(int *)* numComms);
   t->comms.ranks[0]= (int *) malloc(sizeof(int)* sizeAllComms);
   memset(t->comms.ranks[0], 0, sizeof(int)* sizeAllComms);
+  t->comms.nouts= (int *) malloc(sizeof(int)* numComms);
+  memset(t->comms.nouts, 0, sizeof(int)* numComms);
+}
+/* marks the ranks of a list like "0-3,8,12-15" (0-based) */
+void TraceMarkRankList(const char *const spec, int *const map, const int np)
+{
+  char *str= strdup(spec);
+  char *ptr= strtok(str, ",\n ");
+  while(NULL!= ptr) {
+    int r0= -1, r1= -1;
+    const int n= sscanf(ptr, "%d-%d", &r0, &r1);
+    if(n< 2) {
+      r1= r0;
+    }
+    if(n< 1|| r0< 0|| r1< r0|| r1>= np) {
+      Error("Invalid rank(s) \"%s\" for %d ranks; ignored\n", ptr, np);
+    } else {
+      for(int r= r0; r<= r1; ++r) {
+        map[r]= 0;
+      }
+    }
+    ptr= strtok(NULL, ",\n ");
+  }
+  FREE_IF(str);
+}
+/* keeps only the replayed members of each comm, renumbered */
+static void restrictComms(TraceData *const t)
+{
+  for(long c= 0; c< t->comms.num; ++c) {
+    int n= 0;
+    for(int i= 0; i< t->comms.sizes[c]; ++i) {
+      const int r= t->subset.map[t->comms.ranks[c][i]];
+      if(r< 0) {
+        ++(t->comms.nouts[c]);
+      } else {
+        t->comms.ranks[c][n++]= r;
+      }
+    }
+    t->comms.sizes[c]= n;
+  }
+}
+/* node of every replayed rank, 0 if the header does not tell */
+static void readNodes(TraceData *const t, const ParaverFile *const file,
+                      const int ntasks)
+{
+  int *nodes= (int *) malloc(sizeof(int)* ntasks);
+  memset(nodes, 0, sizeof(int)* ntasks);
+  ParaverFileReadTaskNodes(file, nodes);
+
+  t->nodes= (int *) malloc(sizeof(int)* t->numprocs);
+  memset(t->nodes, 0, sizeof(int)* t->numprocs);
+  for(int ip= 0; ip< ntasks; ++ip) {
+    const int p= NULL== t->subset.map? ip: t->subset.map[ip];
+    if(p< 0) {
+      continue;
+    }
+    if(nodes[ip]< 0|| nodes[ip]>= t->numnodes) {
+      Error("%d: invalid node %d of %d in trace header\n", ip, nodes[ip],
+            t->numnodes);
+      continue;
+    }
+    t->nodes[p]= nodes[ip];
+  }
+  FREE_IF(nodes);
+}
+/* returns #ranks to replay out of np, as chosen by --ranks */
+static int selectRanks(TraceData *const t, const int np)
+{
+  const char *const spec= GlOpts.sim_opts.ranks;
+  if(NULL== spec) {
+    return np;
+  }
+
+  int *map= (int *) malloc(sizeof(int)* np);
+  for(int ip= 0; ip< np; ++ip) {
+    map[ip]= -1;
+  }
+  if(0== strncmp("comm:", spec, 5)) {
+    const long c= atol(spec+ 5)- 1;
+    if(c< 0|| c>= t->comms.num) {
+      Error("Invalid communicator in rank-subset \"%s\" (%ld comms)\n", spec,
+            t->comms.num);
+    } else {
+      for(int i= 0; i< t->comms.sizes[c]; ++i) {
+        map[t->comms.ranks[c][i]]= 0;
+      }
+    }
+  } else {
+    TraceMarkRankList(spec, map, np);
+  }
+
+  int n= 0;
+  for(int ip= 0; ip< np; ++ip) {
+    if(0== map[ip]) {
+      map[ip]= n++;
+    }
+  }
+  if(n< 1|| n== np) {
+    ErrorIf(n< 1, "No rank selected by \"%s\"; replaying all\n", spec);
+    FREE_IF(map);
+    return np;
+  }
+
+  t->subset.num= np;
+  t->subset.map= map;
+  restrictComms(t);
+  return n;
 }
 inline static void allocLevel0Data(TraceData *const t)
 {
@@ -33,6 +142,8 @@ inline static void allocLevel0Data(TraceData *const t)
   t->timeline.tflush= (double *) malloc(sizeof(double)* np);
   t->timeline.tdisabled= (double *) malloc(sizeof(double)* np);
   t->timeline.disabledAt= (double *) malloc(sizeof(double)* np);
+  t->timeline.regionAt= (double *) malloc(sizeof(double)* np);
+  t->timeline.tregion= (double *) malloc(sizeof(double)* np);
   t->timeline.hasTraceInit= (bool *) malloc(sizeof(bool)* np);
   t->timeline.hasMPIInit= (bool *) malloc(sizeof(bool)* np);
   const size_t size= sizeof(long)* np;
@@ -49,6 +160,7 @@ inline static void allocLevel0Data(TraceData *const t)
   t->pcolls.iters= (long *) malloc(size);
   t->pcolls.at= (double (**)[2]) malloc(sizeof(double (*)[2])* np);
   t->pcolls.comm= (int **) malloc(sizeof(int *)* np);
+  t->pcolls.bytes= (double **) malloc(sizeof(double *)* np);
 }
 inline static void initLevel0Data(TraceData *const t)
 {
@@ -57,11 +169,13 @@ inline static void initLevel0Data(TraceData *const t)
     t->timeline.extents[ip][0]= -1.0;
     t->timeline.extents[ip][1]= -1.0;
     t->timeline.disabledAt[ip]= -1.0;
+    t->timeline.regionAt[ip]= -1.0;
   }
   memset(t->timeline.tcomp, 0, sizeof(double)* np);
   memset(t->timeline.tmpi, 0, sizeof(double)* np);
   memset(t->timeline.tflush, 0, sizeof(double)* np);
   memset(t->timeline.tdisabled, 0, sizeof(double)* np);
+  memset(t->timeline.tregion, 0, sizeof(double)* np);
   /* memset(t->timeline.disabledAt, 0, sizeof(double)* np); */
   memset(t->timeline.hasTraceInit, 0, sizeof(bool)* np);
   memset(t->timeline.hasMPIInit, 0, sizeof(bool)* np);
@@ -79,6 +193,7 @@ inline static void initLevel0Data(TraceData *const t)
   memset(t->pcolls.iters, 0, size);
   memset(t->pcolls.at, 0, sizeof(double (*)[2])* np);
   memset(t->pcolls.comm, 0, sizeof(long *)* np);
+  memset(t->pcolls.bytes, 0, sizeof(double *)* np);
 }
 
 TraceData *CreateTrace(const ParaverFile *const file)
@@ -94,7 +209,8 @@ TraceData *CreateTrace(const ParaverFile *const file)
   allocComms(t, ParaverFileGetNumComms(file), ParaverFileGetAllCommsSizes(file));
   ParaverFileReadComms(file, t->comms.sizes, t->comms.ranks);
 
-  t->numprocs= ParaverFileGetNumProcs(file);
+  t->numprocs= selectRanks(t, ParaverFileGetNumProcs(file));
+  readNodes(t, file, ParaverFileGetNumProcs(file));
 
   allocLevel0Data(t);
   initLevel0Data(t);
@@ -120,13 +236,18 @@ void allocLevel1Data()
   TraceSetPtrEvtsAt(malloc(sizeof(double)* num));
   TraceSetPtrEvtsId(malloc(sizeof(int)* num));
 
-  TraceSetPtrEvtsCrit(malloc(sizeof(double)* num));
+  if(!GlOpts.online_mon&& (GlOpts.win_mon.enabled|| GlOpts.evt_mon.enabled)) {
+    TraceSetPtrEvtsCrit(malloc(sizeof(double)* num));
+  }
   TraceSetPtrEvtsProc(malloc(sizeof(int)* num));
+  if(GlOpts.sim_opts.whatif.region[0]> 0) {
+    TraceSetPtrEvtsRegion(malloc(sizeof(double)* num));
+  }
 
   TraceSetPtrProcEvtsGids(Alloc2d_long(np, TraceGetPtrNumProcEvts(), num));
 
   /* sends */
-  num= 0;
+  num= TraceGetNumMsgsOut(0);   /* received from outside the subset */
   for(int ip= 0; ip< np; ++ip) {
     num+= TraceGetNumProcSends(ip);
   }
@@ -140,6 +261,7 @@ void allocLevel1Data()
   TraceSetPtrMsgsRecvRank(malloc(sizeof(int)* num));
   TraceSetPtrMsgsSize(malloc(sizeof(double)* num));
   TraceSetPtrMsgsTag(malloc(sizeof(int)* num));
+  TraceSetPtrMsgsProto(malloc(TraceGetSizeMsgsProto()));
 
   TraceSetPtrProcSendsGids(Alloc2d_long(np, TraceGetPtrNumProcSends(), num));
 
@@ -155,6 +277,7 @@ void allocLevel1Data()
 
   TraceSetPtrProcCollsAt(Alloc2d_double2(np, TraceGetPtrNumProcColls(), num));
   TraceSetPtrProcCollsComm(Alloc2d_int(np, TraceGetPtrNumProcColls(), num));
+  TraceSetPtrProcCollsBytes(Alloc2d_double(np, TraceGetPtrNumProcColls(), num));
 }
 
 void initLevel1Data()
@@ -163,11 +286,16 @@ void initLevel1Data()
   memset(TraceGetPtrEvtsAt(), 0, sizeof(double)* num);
   memset(TraceGetPtrEvtsId(), 0, sizeof(int)* num);
 
-  memset(TraceGetPtrEvtsCrit(), 0, sizeof(double)* num);
+  if(TraceHasEvtsCrit()) {
+    memset(TraceGetPtrEvtsCrit(), 0, sizeof(double)* num);
+  }
   /* for(long i= 0; i< num; ++i) { */
   /*   TraceSetEvtCrit(i, -1.0); */
   /* } */
   memset(TraceGetPtrEvtsProc(), 0, sizeof(int)* num);
+  if(TraceHasRegion()) {
+    memset(TraceGetPtrEvtsRegion(), 0, sizeof(double)* num);
+  }
 
   memset(TraceGetPtrProcEvtsGids(0), 0, sizeof(long)* num);
 
@@ -178,6 +306,7 @@ void initLevel1Data()
   memset(TraceGetPtrMsgsRecvRank(), 0, sizeof(int)* num);
   memset(TraceGetPtrMsgsSize(), 0, sizeof(double)* num);
   memset(TraceGetPtrMsgsTag(), 0, sizeof(int)* num);
+  memset(TraceGetPtrMsgsProto(), 0, TraceGetSizeMsgsProto());
 
   memset(TraceGetPtrProcSendsGids(0), 0, sizeof(long)* num);
   memset(TraceGetPtrProcRecvsGids(0), 0, sizeof(long)* num);
@@ -185,6 +314,7 @@ void initLevel1Data()
   num= TraceGetNumAllProcColls();
   memset(TraceGetPtrProcCollsAt(0), 0, sizeof(double[2])* num);
   memset(TraceGetPtrProcCollsComm(0), 0, sizeof(int)* num);
+  memset(TraceGetPtrProcCollsBytes(0), 0, sizeof(double)* num);
 }
 
 void TraceAllocAndInitLevel1Data()
@@ -240,30 +370,33 @@ void TraceConnectEvtsToMsgs()
   memset(Trace0->evts.rlist[1], 0, sizeof(IndexList *)* nevts);
 
   const int np= TraceGetNumProcs();
+  /* messages from/to ranks left out of the replay have only one end */
+  const long nsends= TraceGetNumMsgs()- TraceGetNumMsgsOut(0);
+  const long nrecvs= TraceGetNumMsgs()- TraceGetNumMsgsOut(1);
 
   if(GlOpts.show_opts.diag> 0) {
     long total= 0;
     for(int ip= 0; ip< np; ++ip) {
       total+= TraceGetNumProcSends(ip);
     }
-    if(TraceGetNumMsgs()!= total) {
+    if(nsends!= total) {
       Error("sum(#proc-sends) (%ld) mismatches with #msgs (%ld)\n", total,
-            TraceGetNumMsgs());
+            nsends);
     } else {
       Debug1("sum(#proc-sends) (%ld) matches with #msgs (%ld)\n", total,
-             TraceGetNumMsgs());
+             nsends);
     }
 
     total= 0;
     for(int ip= 0; ip< np; ++ip) {
       total+= TraceGetNumProcRecvs(ip);
     }
-    if(TraceGetNumMsgs()!= total) {
+    if(nrecvs!= total) {
       Error("sum(#proc-recvs) (%ld) mismatches with #msgs (%ld)\n", total,
-            TraceGetNumMsgs());
+            nrecvs);
     } else {
       Debug1("sum(#proc-recvs) (%ld) matches with #msgs (%ld)\n", total,
-             TraceGetNumMsgs());
+             nrecvs);
     }
   }
 
@@ -277,8 +410,8 @@ void TraceConnectEvtsToMsgs()
       ixIt+= 2;
     }
   }
-  ErrorIf(TraceGetNumMsgs()* 2!= ixIt,
-          "#messages= %ld, iterator(x2)= %ld\n", TraceGetNumMsgs(), ixIt);
+  ErrorIf(nsends* 2!= ixIt,
+          "#messages= %ld, iterator(x2)= %ld\n", nsends, ixIt);
 
   ixIt= 0;
   ixl= TraceGetPtrMsgsProcRecvIndex();
@@ -290,6 +423,163 @@ void TraceConnectEvtsToMsgs()
       ixIt+= 2;
     }
   }
-  ErrorIf(TraceGetNumMsgs()* 2!= ixIt,
-          "#messages= %ld, iterator(x2)= %ld\n", TraceGetNumMsgs(), ixIt);
+  ErrorIf(nrecvs* 2!= ixIt,
+          "#messages= %ld, iterator(x2)= %ld\n", nrecvs, ixIt);
+}
+
+void TraceMarkProcSpans(TraceProcEvtPredicate eligible)
+{
+  const int np= TraceGetNumProcs();
+  int **lens= Alloc2d_int(np, TraceGetPtrNumProcEvts(), TraceGetNumEvts());
+  for(int ip= 0; ip< np; ++ip) {
+    int len= 0;
+    for(long ix= TraceGetNumProcEvts(ip)- 1; ix>= 0; --ix) {
+      len= eligible(ip, ix)&& len< INT_MAX? len+ 1: 0;
+      lens[ip][ix]= len;
+    }
+  }
+  TraceSetPtrProcSpansLens(lens);
+}
+
+/* Compacts the event streams, keeping the global order. The predicate is
+ * evaluated on the original streams, i.e. with the dropped neighbours. A
+ * dropped event does not move any clock: its stretch is accounted to the
+ * state of the last kept event before it.
+ * Returns #events dropped.
+ */
+long TraceDropProcEvts(TraceProcEvtPredicate drop)
+{
+  const int np= TraceGetNumProcs();
+  const long num= TraceGetNumEvts();
+  bool *dropped= (bool *) malloc(sizeof(bool)* num);
+  memset(dropped, 0, sizeof(bool)* num);
+
+  long ndropped= 0;
+  for(int ip= 0; ip< np; ++ip) {
+    for(long ix= 0; ix< TraceGetNumProcEvts(ip); ++ix) {
+      if(drop(ip, ix)) {
+        dropped[TraceGetProcEvtGid(ip, ix)]= true;
+        ++ndropped;
+      }
+    }
+  }
+  if(0== ndropped) {
+    FREE_IF(dropped);
+    return 0;
+  }
+
+  double *at= TraceGetPtrEvtsAt();
+  int *id= TraceGetPtrEvtsId();
+  int *proc= TraceGetPtrEvtsProc();
+  double *region= TraceGetPtrEvtsRegion();
+  long n= 0;
+  for(long i= 0; i< num; ++i) {
+    if(dropped[i]) {
+      --(Trace0->pevts.nums[proc[i]]);
+      continue;
+    }
+    at[n]= at[i];
+    id[n]= id[i];
+    proc[n]= proc[i];
+    if(NULL!= region) {
+      region[n]= region[i];
+    }
+    ++n;
+  }
+  FREE_IF(dropped);
+
+  TraceSetNumEvts(n);
+  TraceSetPtrEvtsAt(realloc(at, sizeof(double)* n));
+  TraceSetPtrEvtsId(realloc(id, sizeof(int)* n));
+  TraceSetPtrEvtsProc(realloc(proc, sizeof(int)* n));
+  if(NULL!= region) {
+    TraceSetPtrEvtsRegion(realloc(region, sizeof(double)* n));
+  }
+  if(TraceHasEvtsCrit()) {
+    TraceSetPtrEvtsCrit(realloc(TraceGetPtrEvtsCrit(), sizeof(double)* n));
+    memset(TraceGetPtrEvtsCrit(), 0, sizeof(double)* n);
+  }
+
+  FREE_IF_2D(Trace0->pevts.gids);
+  TraceSetPtrProcEvtsGids(Alloc2d_long(np, TraceGetPtrNumProcEvts(), n));
+  TraceResetItersProcEvts();
+  for(long i= 0; i< n; ++i) {
+    const int p= TraceGetEvtProc(i);
+    TraceSetCurrProcEvtGidTo(p, i);
+    TraceIncrIterProcEvts(p);
+  }
+  TraceResetItersProcEvts();
+
+  return ndropped;
+}
+
+/* moves all recorded times of a rank by dt, e.g. against clock skew */
+void TraceShiftProcTimes(const int p, const double dt)
+{
+  for(long ix= 0; ix< TraceGetNumProcEvts(p); ++ix) {
+    const long gid= TraceGetProcEvtGid(p, ix);
+    TraceSetEvtAt(gid, TraceGetEvtAt(gid)+ dt);
+  }
+  for(long ix= 0; ix< TraceGetNumProcSends(p); ++ix) {
+    double *const t= TraceGetProcSendAts(p, ix);
+    t[0]+= dt; t[1]+= dt;
+  }
+  for(long ix= 0; ix< TraceGetNumProcRecvs(p); ++ix) {
+    double *const t= TraceGetProcRecvAts(p, ix);
+    t[0]+= dt; t[1]+= dt;
+  }
+  double (*const tcolls)[2]= TraceGetPtrProcCollsAt(p);
+  for(long ix= 0; ix< TraceGetNumProcColls(p); ++ix) {
+    tcolls[ix][0]+= dt; tcolls[ix][1]+= dt;
+  }
+  TraceStartProcTimeline(p, TraceGetProcStartTime(p)+ dt);
+  TraceEndProcTimeline(p, TraceGetProcEndTime(p)+ dt);
+}
+
+void TracePartitionProcs(const int n, int *const first)
+{
+  const int np= TraceGetNumProcs();
+  long total= 0;
+  for(int ip= 0; ip< np; ++ip) {
+    total+= TraceGetNumProcEvts(ip);
+  }
+  long sum= 0;
+  first[0]= 0;
+  for(int k= 1, ip= 0; k< n; ++k) {
+    while(ip< np- (n- k)&& (ip<= first[k- 1]|| sum< total* k/ n)) {
+      sum+= TraceGetNumProcEvts(ip++);
+    }
+    first[k]= ip;
+  }
+  first[n]= np;
+}
+
+/* iterators, critical stamps of events and post/settle stamps of messages */
+void TraceShareReplayState()
+{
+  const size_t size= sizeof(long)* TraceGetNumProcs();
+  Trace0->pevts.iters= ShmFromHeap(Trace0->pevts.iters, size);
+  Trace0->psends.iters= ShmFromHeap(Trace0->psends.iters, size);
+  Trace0->precvs.iters= ShmFromHeap(Trace0->precvs.iters, size);
+  Trace0->pcolls.iters= ShmFromHeap(Trace0->pcolls.iters, size);
+  Trace0->evts.crit= ShmFromHeap(Trace0->evts.crit, TraceHasEvtsCrit()?
+                                 sizeof(double)* TraceGetNumEvts(): 0);
+  Trace0->msgs.st= ShmFromHeap(Trace0->msgs.st,
+                               sizeof(double[3])* TraceGetNumMsgs());
+  Trace0->msgs.rt= ShmFromHeap(Trace0->msgs.rt,
+                               sizeof(double[3])* TraceGetNumMsgs());
+}
+void TraceUnshareReplayState()
+{
+  const size_t size= sizeof(long)* TraceGetNumProcs();
+  Trace0->pevts.iters= ShmToHeap(Trace0->pevts.iters, size);
+  Trace0->psends.iters= ShmToHeap(Trace0->psends.iters, size);
+  Trace0->precvs.iters= ShmToHeap(Trace0->precvs.iters, size);
+  Trace0->pcolls.iters= ShmToHeap(Trace0->pcolls.iters, size);
+  Trace0->evts.crit= ShmToHeap(Trace0->evts.crit, TraceHasEvtsCrit()?
+                               sizeof(double)* TraceGetNumEvts(): 0);
+  Trace0->msgs.st= ShmToHeap(Trace0->msgs.st,
+                             sizeof(double[3])* TraceGetNumMsgs());
+  Trace0->msgs.rt= ShmToHeap(Trace0->msgs.rt,
+                             sizeof(double[3])* TraceGetNumMsgs());
 }
@@ -15,6 +15,13 @@
 #include<stdlib.h>
 #include<stdbool.h>
 
+/* p2p protocol of a message, as concluded at the end of its send */
+#define MSG_PROTO_INSTANT 0     /* send starts and ends at the same time */
+#define MSG_PROTO_NONBLOCKING 1 /* whole Isend call */
+#define MSG_PROTO_EAGER 2       /* smaller than the eager limit */
+#define MSG_PROTO_RENDEZVOUS 3  /* waits for the recv to be posted */
+#define MSG_NUM_PROTOS 4
+
 typedef struct IndexList_type__ {
   long i;
   struct IndexList_type__ *next;
@@ -30,6 +37,12 @@ typedef struct TraceData_struct__ {
   int numnodes;                 /* #resources */
   int numapps;
   int numprocs;
+  int *nodes;                   /* len= #procs; node of each rank */
+
+  struct {
+    int num;                    /* #ranks in the trace */
+    int *map;                   /* trace-rank -> replayed rank, -1 if left out */
+  } subset;                     /* NULL map: all ranks replayed */
 
   double extremities[2];
 
@@ -40,16 +53,22 @@ typedef struct TraceData_struct__ {
     double *tflush;       /* len= #procs */
     double *disabledAt;   /* len= #procs */
     double *tdisabled;    /* len= #procs */
+    double *regionAt;     /* len= #procs; < 0: out of the what-if region */
+    double *tregion;      /* len= #procs; in the what-if region */
     bool *hasTraceInit;   /* len= #procs */
     bool *hasMPIInit;     /* len= #procs */
   } timeline;
 
   struct {
     long num;                   /* #communicators in whole trace */
-    int *sizes;
+    int *sizes;                 /* #members among the replayed ranks */
     int **ranks;
+    int *nouts;                 /* #members left out of the replay */
   } comms;
 
+  /* in the order read: in time order per rank, but not across ranks once
+   * their clocks are shifted (skew correction)
+   */
   struct {
     long num;                   /* #events in whole trace */
     long iter;
@@ -57,6 +76,7 @@ typedef struct TraceData_struct__ {
     int *id; /* -1: end, -2: disabled, -3: flush, -4: trace-init, -99: invalid */
     double *crit;
     int *proc;
+    double *region;  /* time in the what-if region till here; NULL: no region */
 
     IndexList **slist[2];
     IndexList **rlist[2];
@@ -71,8 +91,10 @@ typedef struct TraceData_struct__ {
     int *rrank;
     double *size;
     int *tag;
+    unsigned char *proto;       /* 2 bits per message */
     IndexList *ipsmem;
     IndexList *iprmem;
+    long nouts[2];              /* #messages with sender/receiver left out */
   } msgs;
 
   ProcMap pevts;
@@ -85,8 +107,13 @@ typedef struct TraceData_struct__ {
     long *iters;
     double (**at)[2];
     int **comm;
+    double **bytes;  /* max of sent and received by the rank */
   } pcolls;
 
+  struct {
+    int **lens;   /* #events from here on needing only clock accounting */
+  } pspans;
+
 } TraceData;
 
 struct ParaverFile_struct__;
@@ -100,6 +127,12 @@ inline static const char *TraceGetTimeUnit() { return Trace0->timeunit; }
 inline static int TraceGetNumNodes() { return Trace0->numnodes; }
 inline static int TraceGetNumApps() { return Trace0->numapps; }
 inline static int TraceGetNumProcs() { return Trace0->numprocs; }
+inline static int TraceGetProcNode(const int p) { return Trace0->nodes[p]; }
+
+/* rank-subset */
+inline static bool TraceHasRankSubset() { return NULL!= Trace0->subset.map; }
+inline static int TraceGetNumTraceRanks() { return TraceHasRankSubset()? Trace0->subset.num: TraceGetNumProcs(); }
+inline static int TraceGetReplayRank(const int r) { return TraceHasRankSubset()? Trace0->subset.map[r]: r; }
 
 /* timeline-proc-extents */
 inline static double *TraceGetPtrProcTimeline() { return Trace0->timeline.extents[0]; }
@@ -159,6 +192,19 @@ inline static void TraceEndProcDisabled(const int p, const double at)
 inline static double TraceProcDisabledAt(const int p) { return Trace0->timeline.disabledAt[p]; } /* enabled: < 0; disabled: > 0 */
 inline static double TraceGetProcDisabledDuration(const int p) { return Trace0->timeline.tdisabled[p]; }
 
+/* proc-timeline-region-duration */
+inline static void TraceStartProcRegion(const int p, const double at) { Trace0->timeline.regionAt[p]= at; }
+inline static void TraceEndProcRegion(const int p, const double at)
+{
+  if(Trace0->timeline.regionAt[p]> -0.1) {
+    Trace0->timeline.tregion[p]+= at- Trace0->timeline.regionAt[p];
+    Trace0->timeline.regionAt[p]= -1.0;
+  }
+}
+inline static bool TraceProcIsInRegion(const int p) { return Trace0->timeline.regionAt[p]> -0.1; }
+inline static double TraceGetProcRegionDuration(const int p) { return Trace0->timeline.tregion[p]; }
+inline static double TraceGetProcRegionDurationAt(const int p, const double at) { return Trace0->timeline.tregion[p]+ (TraceProcIsInRegion(p)? at- Trace0->timeline.regionAt[p]: 0.0); }
+
 /* proc-timeline-trace-init-is-present */
 inline static void TraceSetTraceInitEvt(const int p) { Trace0->timeline.hasTraceInit[p]= true; }
 inline static bool TraceHasTraceInitEvt(const int p) { return Trace0->timeline.hasTraceInit[p]; }
@@ -191,7 +237,8 @@ inline static int *TraceGetPtrCommsSizes() { return Trace0->comms.sizes; }
 inline static int *TraceGetPtrCommsRanks(const int ic) { return Trace0->comms.ranks[ic]; }
 inline static int TraceGetCommRank(const int ic, const int i) { return Trace0->comms.ranks[ic][i]; }
 inline static int TraceGetCommSize(const int ic) { return Trace0->comms.sizes[ic]; }
-inline static bool TraceIsCommSelf(const int ic) { return 1== Trace0->comms.sizes[ic]; }
+inline static int TraceGetCommNumOutside(const int ic) { return Trace0->comms.nouts[ic]; }
+inline static bool TraceIsCommSelf(const int ic) { return 1== Trace0->comms.sizes[ic]&& 0== Trace0->comms.nouts[ic]; }
 inline static int TraceGetSelfCommRank(const int ic) { return TraceGetCommRank(ic, 0); }
 
 /* evts-num */
@@ -219,10 +266,17 @@ inline static int TraceGetCurrEvtId() { return TraceGetEvtId(TraceGetIterEvts())
 /* evts-crit */
 inline static void TraceSetPtrEvtsCrit(double *crit) { Trace0->evts.crit= crit; }
 inline static double *TraceGetPtrEvtsCrit() { return Trace0->evts.crit; }
+inline static bool TraceHasEvtsCrit() { return NULL!= Trace0->evts.crit; }  /* for offline monitors */
 inline static void TraceSetEvtCrit(const long it, const double crit) { Trace0->evts.crit[it]= crit; }
 inline static void TraceSetCurrEvtCrit(const double crit) { TraceSetEvtCrit(TraceGetIterEvts(), crit); }
 inline static double TraceGetEvtCrit(const long it) { return Trace0->evts.crit[it]; }
 inline static double TraceGetCurrEvtCrit() { return TraceGetEvtCrit(TraceGetIterEvts()); }
+/* evts-region */
+inline static void TraceSetPtrEvtsRegion(double *region) { Trace0->evts.region= region; }
+inline static double *TraceGetPtrEvtsRegion() { return Trace0->evts.region; }
+inline static bool TraceHasRegion() { return NULL!= Trace0->evts.region; }
+inline static void TraceSetEvtRegion(const long it, const double t) { Trace0->evts.region[it]= t; }
+inline static double TraceGetEvtRegion(const long it) { return Trace0->evts.region[it]; }
 /* evts-proc */
 inline static void TraceSetPtrEvtsProc(int *proc) { Trace0->evts.proc= proc; }
 inline static int *TraceGetPtrEvtsProc() { return Trace0->evts.proc; }
@@ -286,6 +340,17 @@ inline static double TraceGetCritCurrProcEvt(const int p) { return TraceGetCritP
 inline static double TraceGetCritPrevProcEvt(const int p) { return 0== TraceGetIterProcEvts(p)? TraceGetProcStartTime(p): TraceGetCritProcEvt(p, TraceGetIterProcEvts(p)- 1); }
 inline static double TraceGetCritNextProcEvt(const int p) { return (TraceGetNumProcEvts(p)- 1)== TraceGetIterProcEvts(p)? TraceGetCritProcEvt(p, TraceGetNumProcEvts(p)- 1): TraceGetCritProcEvt(p, TraceGetIterProcEvts(p)+ 1); }
 
+/* pevts-region */
+/* time in the what-if region from the ix-th event (-1: start) to the next */
+inline static double TraceGetProcRegionSpan(const int p, const long ix)
+{
+  const double t0= ix< 0? 0.0: TraceGetEvtRegion(TraceGetProcEvtGid(p, ix));
+  const double t1= ix+ 1< TraceGetNumProcEvts(p)?
+                   TraceGetEvtRegion(TraceGetProcEvtGid(p, ix+ 1)):
+                   TraceGetProcRegionDuration(p);
+  return t1- t0;
+}
+
 /* pevts-slist */
 inline static void TraceResetProcEvtSends(const int p, const int i,
                                           const long it) { TraceSetEvtSends(i, TraceGetProcEvtGid(p, it), NULL); }
@@ -317,6 +382,9 @@ inline static void TraceRegisterProcEvt(const int p, const double t,
   TraceSetCurrEvtAt(t);
   TraceSetCurrEvtId(evtId);
   TraceSetCurrEvtProc(p);
+  if(TraceHasRegion()) {
+    TraceSetEvtRegion(TraceGetIterEvts(), TraceGetProcRegionDurationAt(p, t));
+  }
 
   TraceSetCurrProcEvtCurrGid(p);
   TraceIncrIterProcEvts(p);
@@ -451,6 +519,9 @@ inline static int TraceGetIdProcEvtAt(const int p, const double at,
 /* msgs-num */
 inline static void TraceSetNumMsgs(const long num) { Trace0->msgs.num= num; }
 inline static long TraceGetNumMsgs() { return Trace0->msgs.num; }
+/* msgs-nouts: 0- sender, 1- receiver left out */
+inline static void TraceIncrNumMsgsOut(const int i) { ++(Trace0->msgs.nouts[i]); }
+inline static long TraceGetNumMsgsOut(const int i) { return Trace0->msgs.nouts[i]; }
 
 /* msgs-iter */
 inline static void TraceResetIterMsgs() { Trace0->msgs.iter= 0; }
@@ -512,6 +583,18 @@ inline static int *TraceGetPtrMsgTag(const long it) { return Trace0->msgs.tag+ i
 inline static void TraceSetCurrMsgTag(const int tag) { Trace0->msgs.tag[TraceGetIterMsgs()]= tag; }
 inline static int *TraceGetPtrCurrMsgTag() { return TraceGetPtrMsgTag(TraceGetIterMsgs()); }
 
+/* msgs-proto */
+inline static void TraceSetPtrMsgsProto(unsigned char *proto) { Trace0->msgs.proto= proto; }
+inline static unsigned char *TraceGetPtrMsgsProto() { return Trace0->msgs.proto; }
+inline static long TraceGetSizeMsgsProto() { return (TraceGetNumMsgs()+ 3)/ 4; }
+inline static void TraceSetMsgProto(const long it, const int proto)
+{
+  unsigned char *const b= Trace0->msgs.proto+ it/ 4;
+  const int shift= 2* (it% 4);
+  *b= (*b& ~(3<< shift))| (proto<< shift);
+}
+inline static int TraceGetMsgProto(const long it) { return (Trace0->msgs.proto[it/ 4]>> (2* (it% 4)))& 3; }
+
 /* msgs-ip[s/r]mem */
 inline static IndexList *TraceGetPtrMsgsProcSendIndex() { return Trace0->msgs.ipsmem; }
 inline static IndexList *TraceGetPtrMsgsProcRecvIndex() { return Trace0->msgs.iprmem; }
@@ -587,14 +670,22 @@ inline static double *TraceGetProcRecvAts(const int p, const long it) { return T
 /* psend-size */
 inline static double TraceGetProcSendSize(const int p, const long it) { return TraceGetMsgSize(TraceGetProcSendGid(p, it)); }
 
+/* psend-proto */
+inline static int TraceGetProcSendProto(const int p, const long it) { return TraceGetMsgProto(TraceGetProcSendGid(p, it)); }
+
 /* psend-precv-multi */
+/* a negative rank is left out of the replay */
 inline static void TraceSetProcSendRecvGids(const int psend, const int precv)
 {
   const long gid= TraceGetIterMsgs();
-  TraceSetCurrProcSendGidTo(psend, gid);
-  TraceIncrIterProcSends(psend);
-  TraceSetCurrProcRecvGidTo(precv, gid);
-  TraceIncrIterProcRecvs(precv);
+  if(psend>= 0) {
+    TraceSetCurrProcSendGidTo(psend, gid);
+    TraceIncrIterProcSends(psend);
+  }
+  if(precv>= 0) {
+    TraceSetCurrProcRecvGidTo(precv, gid);
+    TraceIncrIterProcRecvs(precv);
+  }
 }
 
 /* event to send/recv connection */
@@ -637,10 +728,49 @@ inline static void TraceSetCurrProcCollComm(const int p, const int comm) { Trace
 inline static int TraceGetCommProcColl(const int p, const long ix) { return Trace0->pcolls.comm[p][ix]; }
 inline static int TraceGetCommCurrProcColl(const int p) { return TraceGetCommProcColl(p, TraceGetIterProcColls(p)); }
 
+/* pcolls-bytes */
+inline static void TraceSetPtrProcCollsBytes(double **bytes) { Trace0->pcolls.bytes= bytes; }
+inline static double *TraceGetPtrProcCollsBytes(const int p) { return Trace0->pcolls.bytes[p]; }
+inline static void TraceMaxCurrProcCollBytes(const int p, const double bytes)
+{
+  double *const x= Trace0->pcolls.bytes[p]+ TraceGetIterProcColls(p);
+  if(bytes> *x) {
+    *x= bytes;
+  }
+}
+inline static double TraceGetBytesProcColl(const int p, const long ix) { return Trace0->pcolls.bytes[p][ix]; }
+inline static double TraceGetBytesCurrProcColl(const int p) { return TraceGetBytesProcColl(p, TraceGetIterProcColls(p)); }
+
 /* pcolls-multi */
 inline static void TraceStartProcColl(const int p, const double t) { TraceSetCurrProcCollAt(p, 0, t); }
 inline static void TraceEndProcColl(const int p, const double t) { TraceSetCurrProcCollAt(p, 1, t); TraceIncrIterProcColls(p); }
 
+/* pspans-lens */
+inline static void TraceSetPtrProcSpansLens(int **lens) { Trace0->pspans.lens= lens; }
+inline static bool TraceHasProcSpans() { return NULL!= Trace0->pspans.lens; }
+inline static int TraceGetProcSpanLen(const int p, const long ix) { return Trace0->pspans.lens[p][ix]; }
+inline static int TraceGetCurrProcSpanLen(const int p) { return TraceGetProcSpanLen(p, TraceGetIterProcEvts(p)); }
+
+/* marks the runs of events satisfying the predicate, e.g. message-free */
+typedef bool (*TraceProcEvtPredicate)(const int, const long);
+extern void TraceMarkProcSpans(TraceProcEvtPredicate);
+/* removes the events satisfying the predicate from the streams */
+extern long TraceDropProcEvts(TraceProcEvtPredicate);
+/* moves every recorded time of the rank by the given offset, in place: the
+ * events of all ranks are not re-sorted
+ */
+extern void TraceShiftProcTimes(const int, const double);
+/* n blocks of contiguous ranks of similar #events, block k from first[k] till
+ * first[k+ 1] (len= n+ 1), none empty
+ */
+extern void TracePartitionProcs(const int, int *const);
+/* sets map[r] to 0 for the ranks of a list like "0-3,8,12-15" (0-based) */
+extern void TraceMarkRankList(const char *const, int *const, const int);
+
+/* moves the state changing during the replay into/out of shared memory */
+extern void TraceShareReplayState();
+extern void TraceUnshareReplayState();
+
 /* resets */
 inline static void TraceResetProcIters()
 {
@@ -92,5 +92,11 @@ inline static double Timer_s()
   return ts.tv_sec+ (ts.tv_nsec* 1.0e-9);
 }
 inline static bool SameTime(const double t0, const double t1) { return fabs(t0- t1)< 0.1; }
+/* ascending, for qsort on doubles */
+inline static int CmpDoubles(const void *a, const void *b)
+{
+  const double x= *(const double *) a, y= *(const double *) b;
+  return x< y? -1: (x> y? 1: 0);
+}
 
 #endif  /* CLOCKTALK_UTILS_H__ */
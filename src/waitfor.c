@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2025      High Performance Computing Center Stuttgart,
+ *                         University of Stuttgart.  All rights reserved.
+ *
+ * Authors: Kingshuk Haldar <kingshuk.haldar@hlrs.de>
+ *
+ */
+
+#include"waitfor.h"
+#include"common.h"
+#include"utils.h"
+#include<stdlib.h>
+#include<string.h>
+
+WaitForType WaitFor= { NULL, NULL, NULL, NULL, NULL, NULL, 0, 0, NULL, 0, 0 };
+
+void WaitForInit(const int np)
+{
+  WaitFor.np= np;
+
+  WaitFor.reason= (int *) malloc(sizeof(int)* np);
+  memset(WaitFor.reason, 0, sizeof(int)* np);
+
+  WaitFor.what= (long *) malloc(sizeof(long)* np);
+  memset(WaitFor.what, 0, sizeof(long)* np);
+
+  WaitFor.involved= (bool *) malloc(sizeof(bool)* np);
+  memset(WaitFor.involved, 0, sizeof(bool)* np);
+
+  WaitFor.head= (int *) malloc(sizeof(int)* np);
+  WaitFor.comp= (int *) malloc(sizeof(int)* np);
+
+  WaitFor.maxedges= np;
+  WaitFor.next= (int *) malloc(sizeof(int)* WaitFor.maxedges);
+  WaitFor.to= (int *) malloc(sizeof(int)* WaitFor.maxedges);
+
+  WaitForResetGraph();
+}
+void WaitForFinalize()
+{
+  FREE_IF(WaitFor.reason);
+  FREE_IF(WaitFor.what);
+  FREE_IF(WaitFor.involved);
+  FREE_IF(WaitFor.head);
+  FREE_IF(WaitFor.next);
+  FREE_IF(WaitFor.to);
+  FREE_IF(WaitFor.comp);
+}
+
+void WaitForResetGraph()
+{
+  for(int ip= 0; ip< WaitFor.np; ++ip) {
+    WaitFor.head[ip]= -1;
+    WaitFor.comp[ip]= -1;
+  }
+  memset(WaitFor.involved, 0, sizeof(bool)* WaitFor.np);
+  WaitFor.nedges= 0;
+  WaitFor.ncomps= 0;
+}
+void WaitForAddEdge(const int from, const int to)
+{
+  if(WaitFor.nedges== WaitFor.maxedges) {
+    WaitFor.maxedges*= 2;
+    WaitFor.next= (int *) realloc(WaitFor.next, sizeof(int)* WaitFor.maxedges);
+    WaitFor.to= (int *) realloc(WaitFor.to, sizeof(int)* WaitFor.maxedges);
+  }
+  WaitFor.to[WaitFor.nedges]= to;
+  WaitFor.next[WaitFor.nedges]= WaitFor.head[from];
+  WaitFor.head[from]= WaitFor.nedges;
+  ++(WaitFor.nedges);
+}
+
+/* Tarjan's strongly connected components, iterative to survive large #procs:
+ * every component with a cycle gets an id in comp[].
+ */
+static void markCycles()
+{
+  const int np= WaitFor.np;
+  int *index= (int *) malloc(sizeof(int)* np);
+  int *low= (int *) malloc(sizeof(int)* np);
+  int *edge= (int *) malloc(sizeof(int)* np);    /* next edge to visit */
+  int *stack= (int *) malloc(sizeof(int)* np);
+  int *calls= (int *) malloc(sizeof(int)* np);
+  bool *onstack= (bool *) malloc(sizeof(bool)* np);
+  memset(onstack, 0, sizeof(bool)* np);
+  for(int ip= 0; ip< np; ++ip) {
+    index[ip]= -1;
+  }
+
+  int counter= 0, nstack= 0;
+  for(int root= 0; root< np; ++root) {
+    if(-1!= index[root]|| -1== WaitFor.head[root]) {
+      continue;
+    }
+    int ncalls= 0;
+    calls[ncalls++]= root;
+    index[root]= low[root]= counter++;
+    edge[root]= WaitFor.head[root];
+    stack[nstack++]= root; onstack[root]= true;
+
+    while(ncalls> 0) {
+      const int v= calls[ncalls- 1];
+      if(-1!= edge[v]) {
+        const int w= WaitFor.to[edge[v]];
+        edge[v]= WaitFor.next[edge[v]];
+        if(-1== index[w]) {
+          index[w]= low[w]= counter++;
+          edge[w]= WaitFor.head[w];
+          stack[nstack++]= w; onstack[w]= true;
+          calls[ncalls++]= w;
+        } else if(onstack[w]) {
+          low[v]= MIN(index[w], low[v]);
+        }
+        continue;
+      }
+
+      --ncalls;
+      if(ncalls> 0) {
+        const int u= calls[ncalls- 1];
+        low[u]= MIN(low[v], low[u]);
+      }
+      if(low[v]!= index[v]) {
+        continue;
+      }
+
+      /* v is the root of a component */
+      bool cyclic= stack[nstack- 1]!= v;
+      if(!cyclic) {             /* single member: cyclic only with self-edge */
+        for(int e= WaitFor.head[v]; -1!= e; e= WaitFor.next[e]) {
+          if(v== WaitFor.to[e]) {
+            cyclic= true;
+            break;
+          }
+        }
+      }
+      int w;
+      do {
+        w= stack[--nstack];
+        onstack[w]= false;
+        if(cyclic) {
+          WaitFor.comp[w]= WaitFor.ncomps;
+        }
+      } while(w!= v);
+      if(cyclic) {
+        ++(WaitFor.ncomps);
+      }
+    }
+  }
+
+  FREE_IF(index);
+  FREE_IF(low);
+  FREE_IF(edge);
+  FREE_IF(stack);
+  FREE_IF(calls);
+  FREE_IF(onstack);
+}
+
+/* finds the ranks that are part of cycles, or that wait for completed ranks;
+ * returns #such ranks
+ */
+int WaitForAnalyse(const bool *const completed)
+{
+  markCycles();
+
+  int ninvolved= 0;
+  for(int ip= 0; ip< WaitFor.np; ++ip) {
+    if(-1!= WaitFor.comp[ip]) {
+      WaitFor.involved[ip]= true;
+    } else {
+      for(int e= WaitFor.head[ip]; -1!= e; e= WaitFor.next[e]) {
+        if(completed[WaitFor.to[e]]) {
+          WaitFor.involved[ip]= true;
+          break;
+        }
+      }
+    }
+    if(WaitFor.involved[ip]) {
+      ++ninvolved;
+    }
+  }
+  return ninvolved;
+}
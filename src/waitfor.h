@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2025      High Performance Computing Center Stuttgart,
+ *                         University of Stuttgart.  All rights reserved.
+ *
+ * Authors: Kingshuk Haldar <kingshuk.haldar@hlrs.de>
+ *
+ */
+
+#ifndef REPLAY_WAITFOR_H__
+#define REPLAY_WAITFOR_H__
+
+#include<stdbool.h>
+
+/* reasons for a rank not progressing past its current event:
+ *  recv:      unsettled recv waits for the sender to post (what: msg-gid)
+ *  send:      rendezvous send waits for the receiver to post (what: msg-gid)
+ *  coll:      collective waits for the missing members to enter (what: comm)
+ *  coll-busy: previous collective on the comm is not left by every member
+ *             (what: comm)
+ */
+#define WAIT_NONE 0
+#define WAIT_RECV 1
+#define WAIT_SEND 2
+#define WAIT_COLL 3
+#define WAIT_COLL_BUSY 4
+
+typedef struct {
+  int *reason;                  /* len= #procs */
+  long *what;                   /* len= #procs */
+  bool *involved;               /* len= #procs; in a cycle or a dead-end */
+
+  /* wait-for graph: edges from the blocked rank to the awaited ranks */
+  int *head;                    /* len= #procs */
+  int *next;                    /* len= #edges */
+  int *to;                      /* len= #edges */
+  int nedges;
+  int maxedges;
+
+  int *comp;                    /* len= #procs; cyclic component, -1 otherwise */
+  int ncomps;
+  int np;
+} WaitForType;
+
+extern WaitForType WaitFor;
+
+extern void WaitForInit(const int);
+extern void WaitForFinalize();
+
+extern void WaitForResetGraph();
+extern void WaitForAddEdge(const int, const int);
+extern int WaitForAnalyse(const bool *const);
+
+inline static void WaitForBlock(const int p, const int reason, const long what)
+{
+  WaitFor.reason[p]= reason;
+  WaitFor.what[p]= what;
+}
+inline static int WaitForGetReason(const int p) { return WaitFor.reason[p]; }
+inline static long WaitForGetWhat(const int p) { return WaitFor.what[p]; }
+inline static bool WaitForIsInvolved(const int p) { return WaitFor.involved[p]; }
+inline static int WaitForGetComp(const int p) { return WaitFor.comp[p]; }
+inline static int WaitForGetNumComps() { return WaitFor.ncomps; }
+
+#endif  /* REPLAY_WAITFOR_H__ */
@@ -0,0 +1,477 @@
+/*
+ * Copyright (c) 2025      High Performance Computing Center Stuttgart,
+ *                         University of Stuttgart.  All rights reserved.
+ *
+ * Authors: Kingshuk Haldar <kingshuk.haldar@hlrs.de>
+ *
+ */
+
+#include"whatif.h"
+#include"common.h"
+#include"utils.h"
+#include"trace_data.h"
+#include"paraver.h"
+#include"shm.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<strings.h>
+#include<limits.h>
+#include<math.h>
+
+WhatIfType WhatIf= { 1, NULL, NULL, NULL, NULL, 0, NULL, 0, 0 };
+
+/* speed-up of the selected ranks, only within the region if one is given */
+static double speedUpBurst(const WhatIfLane *const lane, const int p,
+                           const long ix, const double d)
+{
+  if(!WhatIf.selected[p]) {
+    return d;
+  }
+  double in= d;
+  if(TraceHasRegion()) {
+    in= TraceGetProcRegionSpan(p, ix);
+    in= in< 0.0? 0.0: MIN(in, d);
+  }
+  return d- in+ in/ lane->param;
+}
+static const WhatIfKind SpeedUp= { "speed-up", speedUpBurst };
+
+/* perfect load balance: the useful time of a rank up to a collective is
+ * scaled to the average of the members of its comm, and the time after the
+ * last one to the average of all ranks
+ */
+static struct {
+  long *first;                  /* len= #procs+ 1; segments of a rank */
+  long *end;                    /* event closing a segment */
+  double *scale;
+} Balance= { NULL, NULL, NULL };
+
+static double balancedBurst(const WhatIfLane *const lane, const int p,
+                            const long ix, const double d)
+{
+  long lo= Balance.first[p], hi= Balance.first[p+ 1]- 1;
+  while(lo< hi) {
+    const long mid= (lo+ hi)/ 2;
+    if(Balance.end[mid]> ix) {
+      hi= mid;
+    } else {
+      lo= mid+ 1;
+    }
+  }
+  return d* Balance.scale[lo];
+}
+static const WhatIfKind Balanced= { "balanced", balancedBurst };
+
+/* useful time of the segments of a rank, and the comm and instance closing
+ * them (-1 for the last one)
+ */
+static void measureSegments(const int p, int *const comm, long *const seq,
+                            long *const count)
+{
+  long k= Balance.first[p], kc= 0;
+  double u= 0.0, since= TraceGetProcStartTime(p);
+  bool useful= true;
+  for(long ix= 0; ix< TraceGetNumProcEvts(p); ++ix) {
+    const int e= TraceGetIdProcEvt(p, ix);
+    const double t= TraceGetAtProcEvt(p, ix);
+    if(useful) {
+      u+= t- since;
+    }
+    if(e> 0&& ParaverCollEvtIsDimemasCompliant(e)&&
+       kc< TraceGetNumProcColls(p)) {
+      const int c= TraceGetCommProcColl(p, kc++);
+      if(!TraceIsCommSelf(c)) {
+        Balance.end[k]= ix;
+        Balance.scale[k]= u;
+        comm[k]= c;
+        seq[k]= count[c]++;
+        ++k; u= 0.0;
+      }
+    }
+    useful= 0== e;
+    since= t;
+  }
+  if(useful) {
+    u+= TraceGetProcEndTime(p)- since;
+  }
+  Balance.end[k]= LONG_MAX;
+  Balance.scale[k]= u;
+  comm[k]= -1;
+  seq[k]= 0;
+  Balance.first[p+ 1]= k+ 1;
+}
+static void balanceBursts(const int np)
+{
+  long nsegs= 0;
+  Balance.first= (long *) malloc(sizeof(long)* (np+ 1));
+  Balance.first[0]= 0;
+  for(int ip= 0; ip< np; ++ip) {
+    nsegs+= TraceGetNumProcColls(ip)+ 1;
+  }
+  Balance.end= (long *) malloc(sizeof(long)* nsegs);
+  Balance.scale= (double *) malloc(sizeof(double)* nsegs);
+  int *comm= (int *) malloc(sizeof(int)* nsegs);
+  long *seq= (long *) malloc(sizeof(long)* nsegs);
+  const long nc= TraceGetNumComms();
+  long *count= (long *) malloc(sizeof(long)* nc);
+  memset(count, 0, sizeof(long)* nc);
+  long *offset= (long *) malloc(sizeof(long)* nc);
+  memset(offset, 0, sizeof(long)* nc);
+  for(int ip= 0; ip< np; ++ip) {
+    measureSegments(ip, comm, seq, count);
+    for(long k= Balance.first[ip]; k< Balance.first[ip+ 1]- 1; ++k) {
+      offset[comm[k]]= MAX(offset[comm[k]], count[comm[k]]);
+      count[comm[k]]= 0;
+    }
+  }
+  FREE_IF(count);
+
+  /* sums over the members of instance i of comm c at offset[c]+ i, over all
+   * ranks for the last segments at 0
+   */
+  long ninst= 1;
+  for(long c= 0; c< nc; ++c) {
+    const long n= offset[c];
+    offset[c]= ninst;
+    ninst+= n;
+  }
+  /* the work is shared by the members with any: a segment without useful
+   * time has no burst to stretch, and stays empty
+   */
+  double *sum= (double *) malloc(sizeof(double)* ninst* 2);
+  memset(sum, 0, sizeof(double)* ninst* 2);
+  double *const balanced= sum+ ninst;
+  int *nmembers= (int *) malloc(sizeof(int)* ninst);
+  memset(nmembers, 0, sizeof(int)* ninst);
+  const long nall= Balance.first[np];
+  for(long k= 0; k< nall; ++k) {
+    const long i= comm[k]< 0? 0: offset[comm[k]]+ seq[k];
+    if(Balance.scale[k]> 0.0) {
+      sum[i]+= Balance.scale[k];
+      ++(nmembers[i]);
+    }
+  }
+  for(long k= 0; k< nall; ++k) {
+    const long i= comm[k]< 0? 0: offset[comm[k]]+ seq[k];
+    if(Balance.scale[k]> 0.0) {
+      const double avg= sum[i]/ nmembers[i];
+      balanced[i]+= avg;
+      Balance.scale[k]= avg/ Balance.scale[k];
+    } else {
+      Balance.scale[k]= 1.0;
+    }
+  }
+  for(long i= 0; i< ninst; ++i) {
+    if(fabs(balanced[i]- sum[i])> 1.0e-9* sum[i]+ 1.0e-6) {
+      Debug1("balanced: work of instance %ld not conserved (%.3lf -> %.3lf ns)\n",
+             i, sum[i], balanced[i]);
+    }
+  }
+  FREE_IF(nmembers);
+  FREE_IF(sum);
+  FREE_IF(offset);
+  FREE_IF(seq);
+  FREE_IF(comm);
+}
+
+/* noise replicas: useful bursts perturbed by draws that depend only on the
+ * seed, the replica, the rank and the event starting the burst, so that
+ * they are the same however the replay is shared among workers
+ */
+enum { NOISE_GAUSS= 0, NOISE_EXP, NOISE_EMPIRICAL, NOISE_NUM_DISTS };
+static const char *const NoiseDists[NOISE_NUM_DISTS]= {
+  "gauss", "exp", "empirical"
+};
+static struct {
+  int dist;
+  double scale;
+  double *sample;               /* len= #sample; relative burst durations */
+  long nsample;
+} Noise= { -1, 0.0, NULL, 0 };
+
+/* finaliser of splitmix64 */
+inline static unsigned long long mix64(unsigned long long z)
+{
+  z+= 0x9e3779b97f4a7c15ULL;
+  z= (z^ (z>> 30))* 0xbf58476d1ce4e5b9ULL;
+  z= (z^ (z>> 27))* 0x94d049bb133111ebULL;
+  return z^ (z>> 31);
+}
+/* uniform in (0, 1), k-th draw for a burst of a replica */
+static double noiseUniform(const int i, const int p, const long ix,
+                           const int k)
+{
+  unsigned long long z= mix64(GlOpts.sim_opts.whatif.seed);
+  z= mix64(z^ (unsigned long long) i);
+  z= mix64(z^ (unsigned long long) p);
+  z= mix64(z^ (unsigned long long) (ix+ 1));
+  z= mix64(z^ (unsigned long long) k);
+  return ((z>> 11)+ 0.5)* 0x1.0p-53;
+}
+static double noisyBurst(const WhatIfLane *const lane, const int p,
+                         const long ix, const double d)
+{
+  const int l= lane- WhatIf.lane;
+  const int i= l- WhatIfGetFirstReplica();  /* whatever other lanes there are */
+  const double u= noiseUniform(i, p, ix, 0);
+  double f= 1.0;
+  switch(Noise.dist) {
+  case NOISE_GAUSS:
+    f+= Noise.scale* sqrt(-2.0* log(u))* cos(2.0* acos(-1.0)* noiseUniform(i, p, ix, 1));
+    break;
+  case NOISE_EXP:
+    f-= Noise.scale* log(u);
+    break;
+  case NOISE_EMPIRICAL:
+    f+= Noise.scale* (Noise.sample[(long) (u* Noise.nsample)]- 1.0);
+    break;
+  default:
+    break;
+  }
+  const double b= f> 0.0? d* f: 0.0;
+  WhatIf.noise[l* WhatIf.np+ p]+= b- d;
+  return b;
+}
+static const WhatIfKind Noisy= { "noise", noisyBurst };
+
+/* bursts of a rank between the same pair of MPI calls are repetitions */
+typedef struct {
+  unsigned long long key;       /* ids of the calls before and after */
+  double d;
+} NoiseBurst;
+static int cmpNoiseBursts(const void *a, const void *b)
+{
+  const unsigned long long x= ((const NoiseBurst *) a)->key,
+                           y= ((const NoiseBurst *) b)->key;
+  return x< y? -1: (x> y? 1: 0);
+}
+/* durations of repeated bursts relative to their mean */
+static void sampleBursts(const int np)
+{
+  long nmax= 0;
+  for(int ip= 0; ip< np; ++ip) {
+    nmax= MAX(nmax, TraceGetNumProcEvts(ip));
+  }
+  NoiseBurst *bursts= (NoiseBurst *) malloc(sizeof(NoiseBurst)* (nmax+ 1));
+  long total= 0;
+  for(int ip= 0; ip< np; ++ip) {
+    total+= TraceGetNumProcEvts(ip);
+  }
+  Noise.sample= (double *) malloc(sizeof(double)* (total+ 1));
+  Noise.nsample= 0;
+
+  for(int ip= 0; ip< np; ++ip) {
+    const long n= TraceGetNumProcEvts(ip);
+    long nb= 0;
+    for(long ix= 0; ix< n; ++ix) {
+      if(0!= TraceGetIdProcEvt(ip, ix)) {
+        continue;
+      }
+      const int prev= ix> 0? TraceGetIdProcEvt(ip, ix- 1): 0;
+      const int next= ix+ 1< n? TraceGetIdProcEvt(ip, ix+ 1): 0;
+      const double tnext= ix+ 1< n? TraceGetAtProcEvt(ip, ix+ 1):
+                          TraceGetProcEndTime(ip);
+      bursts[nb].key= ((unsigned long long) (unsigned int) prev<< 32)| (unsigned int) next;
+      bursts[nb].d= tnext- TraceGetAtProcEvt(ip, ix);
+      ++nb;
+    }
+    qsort(bursts, nb, sizeof(NoiseBurst), cmpNoiseBursts);
+    for(long i0= 0, i1= 0; i0< nb; i0= i1) {
+      double sum= 0.0;
+      for(i1= i0; i1< nb&& bursts[i1].key== bursts[i0].key; ++i1) {
+        sum+= bursts[i1].d;
+      }
+      if(i1- i0< 2|| sum<= 0.0) {
+        continue;
+      }
+      const double mean= sum/ (i1- i0);
+      for(long i= i0; i< i1; ++i) {
+        Noise.sample[Noise.nsample++]= bursts[i].d/ mean;
+      }
+    }
+  }
+  FREE_IF(bursts);
+
+  if(0== Noise.nsample) {       /* no repetitions: no noise */
+    Noise.sample[Noise.nsample++]= 1.0;
+  }
+  Log1("Empirical noise: %ld repeated bursts\n", Noise.nsample);
+}
+
+/* "gauss|exp|empirical[:scale]" */
+static int addReplicas(const char *const spec, WhatIfLane *const lanes,
+                       const int np)
+{
+  char *str= strdup(spec);
+  char *scale= strchr(str, ':');
+  if(NULL!= scale) {
+    *scale++= '\0';
+  }
+  Noise.dist= -1;
+  for(int k= 0; k< NOISE_NUM_DISTS; ++k) {
+    if(0== strcasecmp(str, NoiseDists[k])) {
+      Noise.dist= k;
+    }
+  }
+  Noise.scale= NULL!= scale? atof(scale):
+               (NOISE_EMPIRICAL== Noise.dist? 1.0: 0.05);
+  const int n= GlOpts.sim_opts.whatif.nreplicas;
+  if(Noise.dist< 0|| Noise.scale< 0.0|| n< 1) {
+    Error("Invalid noise \"%s\" with %d replicas, ignored\n", spec, n);
+    FREE_IF(str);
+    return 0;
+  }
+  FREE_IF(str);
+
+  if(NOISE_EMPIRICAL== Noise.dist) {
+    sampleBursts(np);
+  }
+  for(int i= 0; i< n; ++i) {
+    lanes[i].kind= &Noisy;
+    lanes[i].param= Noise.scale;
+    snprintf(lanes[i].label, sizeof(lanes[i].label), "noise-%d", i);
+  }
+  return n;
+}
+
+/* one lane per speed-up of "2,4,..." */
+static int addSpeedUps(const char *const spec, WhatIfLane *const lanes)
+{
+  int n= 0;
+  char *str= strdup(spec);
+  char *save= NULL;
+  for(char *tok= strtok_r(str, ",", &save); NULL!= tok;
+      tok= strtok_r(NULL, ",", &save)) {
+    const double k= atof(tok);
+    if(k<= 0.0) {
+      Error("Invalid speed-up \"%s\", ignored\n", tok);
+      continue;
+    }
+    lanes[n].kind= &SpeedUp;
+    lanes[n].param= k;
+    snprintf(lanes[n].label, sizeof(lanes[n].label), "x%g", k);
+    ++n;
+  }
+  FREE_IF(str);
+  return n;
+}
+
+static void selectRanks(const int np)
+{
+  WhatIf.selected= (bool *) malloc(sizeof(bool)* np);
+  const char *const spec= GlOpts.sim_opts.whatif.ranks;
+  if(NULL== spec) {
+    for(int ip= 0; ip< np; ++ip) {
+      WhatIf.selected[ip]= true;
+    }
+    return;
+  }
+  int *map= (int *) malloc(sizeof(int)* np);
+  for(int ip= 0; ip< np; ++ip) {
+    map[ip]= -1;
+  }
+  TraceMarkRankList(spec, map, np);
+  for(int ip= 0; ip< np; ++ip) {
+    WhatIf.selected[ip]= 0== map[ip];
+  }
+  FREE_IF(map);
+}
+
+void WhatIfInit(const int np)
+{
+  int nmax= GlOpts.sim_opts.whatif.balance? 2: 1;
+  const char *const noise= GlOpts.sim_opts.whatif.noise;
+  if(NULL!= noise) {
+    nmax+= MAX(GlOpts.sim_opts.whatif.nreplicas, 0);
+  }
+  const char *const factors= GlOpts.sim_opts.whatif.factors;
+  for(const char *c= factors; NULL!= c&& '\0'!= *c; ++c) {
+    nmax+= ','== *c? 1: 0;
+  }
+  WhatIf.lane= (WhatIfLane *) malloc(sizeof(WhatIfLane)* (1+ nmax));
+  memset(WhatIf.lane, 0, sizeof(WhatIfLane)* (1+ nmax));
+  snprintf(WhatIf.lane[0].label, sizeof(WhatIf.lane[0].label), "recorded");
+  WhatIf.nlanes= 1;
+  if(NULL!= factors) {
+    WhatIf.nlanes+= addSpeedUps(factors, WhatIf.lane+ WhatIf.nlanes);
+  }
+  if(GlOpts.sim_opts.whatif.balance) {
+    WhatIfLane *const lane= WhatIf.lane+ WhatIf.nlanes++;
+    lane->kind= &Balanced;
+    snprintf(lane->label, sizeof(lane->label), "balanced");
+    balanceBursts(np);
+  }
+  WhatIf.nreplicas= NULL!= noise? addReplicas(noise, WhatIf.lane+ WhatIf.nlanes,
+                                              np): 0;
+  WhatIf.nlanes+= WhatIf.nreplicas;
+  WhatIf.np= np;
+  if(!WhatIfHasLanes()) {
+    return;
+  }
+
+  selectRanks(np);
+  WhatIf.burst= (long *) malloc(sizeof(long)* np);
+  for(int ip= 0; ip< np; ++ip) {
+    WhatIf.burst[ip]= -1;       /* from the start till the first event */
+  }
+  WhatIf.noise= (double *) malloc(sizeof(double)* WhatIf.nlanes* np);
+  memset(WhatIf.noise, 0, sizeof(double)* WhatIf.nlanes* np);
+
+  /* ends left out of the replay are posted at their recorded times */
+  WhatIf.nmsgs= TraceGetNumMsgs();
+  const size_t size= sizeof(double)* 2* WhatIf.nmsgs* (WhatIf.nlanes- 1);
+  WhatIf.posts= (double *) malloc(size);
+  memset(WhatIf.posts, 0, size);
+  for(long g= 0; g< WhatIf.nmsgs; ++g) {
+    for(int l= 1; l< WhatIf.nlanes; ++l) {
+      if(TraceGetMsgSendRank(g)< 0) {
+        WhatIfSetSendPost(l, g, TraceGetMsgSendAt(g, 2));
+      }
+      if(TraceGetMsgRecvRank(g)< 0) {
+        WhatIfSetRecvPost(l, g, TraceGetMsgRecvAt(g, 2));
+      }
+    }
+  }
+  Log1("What-if lanes: %d\n", WhatIf.nlanes- 1);
+}
+void WhatIfFinalize()
+{
+  FREE_IF(WhatIf.noise);
+  FREE_IF(Noise.sample);
+  FREE_IF(Balance.scale);
+  FREE_IF(Balance.end);
+  FREE_IF(Balance.first);
+  FREE_IF(WhatIf.posts);
+  FREE_IF(WhatIf.burst);
+  FREE_IF(WhatIf.selected);
+  FREE_IF(WhatIf.lane);
+  WhatIf.nlanes= 1;
+  WhatIf.nreplicas= 0;
+}
+
+void WhatIfSetBurst(const int p, const long i) { WhatIf.burst[p]= TraceGetIterProcEvts(p)+ i; }
+
+/* moves the state of the lanes into/out of memory shared with replay workers */
+void WhatIfShare()
+{
+  if(!WhatIfHasLanes()) {
+    return;
+  }
+  WhatIf.burst= ShmFromHeap(WhatIf.burst, sizeof(long)* WhatIf.np);
+  WhatIf.noise= ShmFromHeap(WhatIf.noise, sizeof(double)* WhatIf.nlanes*
+                            WhatIf.np);
+  WhatIf.posts= ShmFromHeap(WhatIf.posts, sizeof(double)* 2* WhatIf.nmsgs*
+                            (WhatIf.nlanes- 1));
+}
+void WhatIfUnshare()
+{
+  if(!WhatIfHasLanes()) {
+    return;
+  }
+  WhatIf.burst= ShmToHeap(WhatIf.burst, sizeof(long)* WhatIf.np);
+  WhatIf.noise= ShmToHeap(WhatIf.noise, sizeof(double)* WhatIf.nlanes*
+                          WhatIf.np);
+  WhatIf.posts= ShmToHeap(WhatIf.posts, sizeof(double)* 2* WhatIf.nmsgs*
+                          (WhatIf.nlanes- 1));
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2025      High Performance Computing Center Stuttgart,
+ *                         University of Stuttgart.  All rights reserved.
+ *
+ * Authors: Kingshuk Haldar <kingshuk.haldar@hlrs.de>
+ *
+ */
+
+#ifndef REPLAY_WHATIF_H__
+#define REPLAY_WHATIF_H__
+
+#include"shm.h"
+#include<stddef.h>
+#include<stdbool.h>
+
+/* What-if lanes replay the trace with changed useful bursts, along with the
+ * replay of the trace as recorded (lane 0), in the same traversal. As only
+ * the bursts differ, every lane settles the same events in the same order:
+ * a lane has its own critical clocks (see clocks.h), message posts and
+ * collective entries. Lane 0 keeps its message posts in the trace.
+ */
+struct WhatIfLane_struct__;
+typedef struct {
+  const char *name;
+  /* duration of a useful burst of a rank, starting at its ix-th event */
+  double (*burst)(const struct WhatIfLane_struct__ *const, const int,
+                  const long, const double);
+} WhatIfKind;
+
+typedef struct WhatIfLane_struct__ {
+  const WhatIfKind *kind;       /* NULL: as recorded */
+  double param;                 /* e.g. speed-up */
+  char label[32];
+} WhatIfLane;
+
+typedef struct {
+  int nlanes;                   /* incl. lane 0 */
+  WhatIfLane *lane;             /* len= #lanes */
+  bool *selected;               /* len= #procs; ranks changed */
+  long *burst;                  /* len= #procs; event starting the useful burst */
+  double *posts;                /* len= 2* #msgs* (#lanes- 1); send, recv (end once settled) */
+  int nreplicas;                /* noise replicas, the last lanes */
+  double *noise;                /* len= #lanes* #procs; added to useful time */
+  long nmsgs;
+  int np;
+} WhatIfType;
+
+extern WhatIfType WhatIf;
+
+extern void WhatIfInit(const int);
+extern void WhatIfFinalize();
+extern void WhatIfShare();
+extern void WhatIfUnshare();
+extern void WhatIfSetBurst(const int, const long);
+
+inline static int WhatIfGetNumLanes() { return WhatIf.nlanes; }
+inline static bool WhatIfHasLanes() { return WhatIf.nlanes> 1; }
+inline static const char *WhatIfGetLaneLabel(const int l) { return WhatIf.lane[l].label; }
+inline static int WhatIfGetNumReplicas() { return WhatIf.nreplicas; }
+inline static int WhatIfGetFirstReplica() { return WhatIf.nlanes- WhatIf.nreplicas; }
+inline static double WhatIfGetNoise(const int l, const int p) { return WhatIf.noise[l* WhatIf.np+ p]; }
+
+/* a useful burst starts at the i-th event from the current one of a rank */
+inline static void WhatIfStartBurst(const int p, const long i)
+{
+  if(WhatIfHasLanes()) {
+    WhatIfSetBurst(p, i);
+  }
+}
+/* duration of the current useful burst of a rank in a lane other than 0 */
+inline static double WhatIfBurst(const int l, const int p, const double d)
+{
+  const WhatIfLane *const lane= WhatIf.lane+ l;
+  return lane->kind->burst(lane, p, WhatIf.burst[p], d);
+}
+
+/* message posts of lanes other than 0 */
+inline static double *whatIfPosts(const int l, const long gid) { return WhatIf.posts+ 2* ((l- 1)* WhatIf.nmsgs+ gid); }
+inline static double WhatIfGetSendPost(const int l, const long gid) { return ShmLoadDouble(whatIfPosts(l, gid)); }
+inline static void WhatIfSetSendPost(const int l, const long gid,
+                                     const double t) { ShmStoreDouble(whatIfPosts(l, gid), t); }
+inline static double WhatIfGetRecvPost(const int l, const long gid) { return ShmLoadDouble(whatIfPosts(l, gid)+ 1); }
+inline static void WhatIfSetRecvPost(const int l, const long gid,
+                                     const double t) { ShmStoreDouble(whatIfPosts(l, gid)+ 1, t); }
+
+#endif  /* REPLAY_WHATIF_H__ */